@@ -2,82 +2,947 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <spawn.h>
+#include <climits>
+#include <ctime>
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
 
-int main() {
-    int pipe1[2], pipe2[2];
+#include "frame_protocol.h"
+#include "parent_common.h"
+#include "thread_mode.h"
+#include "stage_pipeline.h"
 
-    // Создание двух пайпов
-    if (pipe(pipe1) == -1 || pipe(pipe2) == -1) {
-        const char* errorMsg = "Pipe creation failed\n";
-        write(STDERR_FILENO, errorMsg, strlen(errorMsg));
-        exit(1);
+extern char** environ;
+
+// Размер блока чтения stdin
+const size_t READ_CHUNK = 1 << 20;
+// Накопленные для ребёнка строки отправляются одним write, когда их набирается столько байт
+const size_t FLUSH_THRESHOLD = 64 * 1024;
+// Порция, перекладываемая ядром за один splice/tee в режиме без копирования
+const size_t SPLICE_CHUNK = 64 * 1024;
+// Упорядоченный режим: наибольший кадр и сколько кадров может ждать вывода одновременно
+const size_t FRAME_PAYLOAD = 64 * 1024;
+const size_t REORDER_WINDOW = 256;
+// Событийный цикл: сколько байт может ждать отправки одному ребёнку, прежде чем вход остановится
+const size_t QUEUE_LIMIT = 1 << 20;
+
+enum RoutingPolicy {
+    ROUTE_LEAST_LOADED, // Строка уходит ребёнку с наименьшей очередью
+    ROUTE_WEIGHTED      // Строка уходит случайному ребёнку согласно весам
+};
+
+enum SpawnMethod {
+    SPAWN_POSIX, // posix_spawn: в glibc это clone(CLONE_VM | CLONE_VFORK) без копирования таблиц страниц
+    SPAWN_FORK   // Классические fork + exec
+};
+
+// Как и где запускаются дети; путь к remove_vowels вычисляется один раз при старте
+struct SpawnConfig {
+    std::string path;
+    SpawnMethod method;
+    size_t maxWorkers;
+    bool prefork;                 // Запустить всех детей до чтения входа
+    bool ordered;                 // Дети говорят кадрами и возвращают результат через свой пайп
+    bool utf8;                    // Дети удаляют и гласные кириллицы (remove_vowels --utf8)
+    unsigned long long spawned;
+    double spawnSeconds;          // Суммарное время вызовов запуска в родителе
+    double maxSpawnSeconds;
+};
+
+SpawnConfig spawnConfig = {"", SPAWN_POSIX, 1, false, false, false, 0, 0.0, 0.0};
+
+// epoll событийного цикла; новые дети регистрируются в нём сразу при запуске
+int epollFd = -1;
+const uint64_t STDIN_TOKEN = ~(uint64_t)0;
+
+struct Worker {
+    pid_t pid;
+    int fd;                       // Конец пайпа для записи
+    int weight;                   // Доля строк, уходящих этому ребёнку
+    std::vector<char> pending;    // Строки, ещё не записанные в пайп
+    size_t pendingSent;           // Сколько байт pending уже ушло (неблокирующая запись)
+    int resultFd;                 // Пайп результатов в упорядоченном режиме, иначе -1
+    std::vector<char> results;    // Буфер чтения результатов
+    size_t resultsLen;            // Сколько байт в results занято недочитанным кадром
+    unsigned long long queued;    // Оценка непрочитанных ребёнком байт (пайп + pending)
+    unsigned long long maxQueued; // Статистика глубины очереди по снимкам событийного цикла
+    unsigned long long queueSum;
+    unsigned long long queueSamples;
+    unsigned long long bytesSent;
+    unsigned long long linesSent;
+};
+
+
+// Разбор "80,20,..." в веса детей, количество весов задаёт количество детей
+bool parseWeights(const char* text, std::vector<int>& weights) {
+    weights.clear();
+    long total = 0;
+    char* end;
+    while (true) {
+        long weight = strtol(text, &end, 10);
+        if (end == text || weight < 0) return false;
+        weights.push_back((int)weight);
+        total += weight;
+        if (*end == '\0') break;
+        if (*end != ',') return false;
+        text = end + 1;
     }
+    return total > 0;
+}
+
+// Количество байт, лежащих в пайпе и ещё не прочитанных ребёнком
+unsigned long long pipeDepth(int fd) {
+    int depth = 0;
+    if (ioctl(fd, FIONREAD, &depth) == -1) return 0;
+    return depth;
+}
 
-    // Создание первого дочернего процесса
-    pid_t child1 = fork();
-    if (child1 < 0) {
-        const char* errorMsg = "Fork failed for child1\n";
-        write(STDERR_FILENO, errorMsg, strlen(errorMsg));
-        exit(1);
+// Ищет remove_vowels рядом с исполняемым файлом родителя, затем в текущем каталоге,
+// чтобы запуск не зависел от того, откуда вызван конвейер
+std::string resolveWorkerPath(const char* requested) {
+    if (requested != NULL) {
+        if (access(requested, X_OK) != 0) fail("Worker executable is not runnable\n");
+        return requested;
     }
+    char self[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len > 0) {
+        self[len] = '\0';
+        std::string candidate(self);
+        candidate = candidate.substr(0, candidate.rfind('/') + 1) + "remove_vowels";
+        if (access(candidate.c_str(), X_OK) == 0) return candidate;
+    }
+    char cwd[PATH_MAX];
+    if (getcwd(cwd, sizeof(cwd)) != NULL) {
+        std::string candidate = std::string(cwd) + "/remove_vowels";
+        if (access(candidate.c_str(), X_OK) == 0) return candidate;
+    }
+    fail("remove_vowels not found next to the parent or in the current directory\n");
+    return "";
+}
 
-    if (child1 == 0) {
-        // Во первом дочернем процессе
-        close(pipe1[1]); // Закрываем конец для записи
-        dup2(pipe1[0], STDIN_FILENO); // Перенаправляем стандартный ввод на pipe1
-        close(pipe1[0]); // Закрываем конец для чтения
-        execl("./remove_vowels", "remove_vowels", (char *)NULL); // Запуск нового исполняемого файла
-        perror("execl failed"); // Если execl не сработает
+// Запускает remove_vowels со стандартным вводом из readFd и, если writeFd != -1, выводом в writeFd.
+// Все остальные дескрипторы родителя открыты с O_CLOEXEC и до ребёнка не доходят.
+pid_t spawnProcess(SpawnMethod method, const std::string& path, int readFd, int writeFd, bool framed) {
+    char* args[5] = {(char*)"remove_vowels", NULL, NULL, NULL, NULL};
+    int argCount = 1;
+    if (framed) args[argCount++] = (char*)"--framed";
+    // Общий stdout с другими детьми: ребёнок пишет только целые строки
+    if (!framed && writeFd == -1) args[argCount++] = (char*)"--lines";
+    if (spawnConfig.utf8) args[argCount++] = (char*)"--utf8";
+    if (method == SPAWN_POSIX) {
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, readFd, STDIN_FILENO); // Перенаправляем стандартный ввод на пайп
+        if (writeFd != -1) {
+            posix_spawn_file_actions_adddup2(&actions, writeFd, STDOUT_FILENO);
+        }
+        pid_t child;
+        int rc = posix_spawn(&child, path.c_str(), &actions, NULL, args, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        if (rc != 0) {
+            fail("posix_spawn failed\n");
+        }
+        return child;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        fail("Fork failed\n");
+    }
+    if (child == 0) {
+        dup2(readFd, STDIN_FILENO); // Перенаправляем стандартный ввод на пайп
+        if (writeFd != -1) {
+            dup2(writeFd, STDOUT_FILENO);
+        }
+        execv(path.c_str(), args); // Запуск нового исполняемого файла
+        perror("execv failed"); // Если execv не сработает
         _exit(1);
     }
+    return child;
+}
 
-    // Создание второго дочернего процесса
-    pid_t child2 = fork();
-    if (child2 < 0) {
-        const char* errorMsg = "Fork failed for child2\n";
-        write(STDERR_FILENO, errorMsg, strlen(errorMsg));
-        exit(1);
+// Переводит входной и результатный пайпы ребёнка в неблокирующий режим и ставит их под epoll
+void watchWorker(Worker& worker, size_t index) {
+    epoll_event event;
+    fcntl(worker.fd, F_SETFL, O_NONBLOCK);
+    event.events = EPOLLOUT | EPOLLET;
+    event.data.u64 = index * 2;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, worker.fd, &event) == -1) fail("epoll_ctl failed\n");
+    if (worker.resultFd != -1) {
+        fcntl(worker.resultFd, F_SETFL, O_NONBLOCK);
+        event.events = EPOLLIN | EPOLLET;
+        event.data.u64 = index * 2 + 1;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, worker.resultFd, &event) == -1) fail("epoll_ctl failed\n");
     }
+}
 
-    if (child2 == 0) {
-        // Во втором дочернем процессе
-        close(pipe2[1]); // Закрываем конец для записи
-        dup2(pipe2[0], STDIN_FILENO); // Перенаправляем стандартный ввод на pipe2
-        close(pipe2[0]); // Закрываем конец для чтения
-        execl("./remove_vowels", "remove_vowels", (char *)NULL); // Запуск нового исполняемого файла
-        perror("execl failed"); // Если execl не сработает
-        _exit(1);
+// Создаёт пайп и ребёнка, читающего из него, и добавляет его в пул
+Worker& startWorker(std::vector<Worker>& workers, int weight) {
+    int fds[2];
+    // O_CLOEXEC: следующий ребёнок не унаследует конец записи предыдущего и не помешает ему увидеть EOF
+    if (pipe2(fds, O_CLOEXEC) == -1) {
+        fail("Pipe creation failed\n");
+    }
+    // В упорядоченном режиме ребёнок пишет результаты в свой пайп, а не в общий stdout
+    int results[2] = {-1, -1};
+    if (spawnConfig.ordered && pipe2(results, O_CLOEXEC) == -1) {
+        fail("Pipe creation failed\n");
+    }
+    double start = nowSeconds();
+    pid_t pid = spawnProcess(spawnConfig.method, spawnConfig.path, fds[0], results[1], spawnConfig.ordered);
+    double elapsed = nowSeconds() - start;
+    spawnConfig.spawned++;
+    spawnConfig.spawnSeconds += elapsed;
+    spawnConfig.maxSpawnSeconds = std::max(spawnConfig.maxSpawnSeconds, elapsed);
+    close(fds[0]); // В родителе конец для чтения не нужен
+    if (spawnConfig.ordered) {
+        close(results[1]);
+    }
+
+    workers.push_back(Worker());
+    Worker& worker = workers.back();
+    worker.pid = pid;
+    worker.fd = fds[1];
+    worker.resultFd = results[0];
+    worker.resultsLen = 0;
+    worker.pendingSent = 0;
+    worker.weight = weight;
+    worker.queued = 0;
+    worker.bytesSent = 0;
+    worker.linesSent = 0;
+    worker.maxQueued = 0;
+    worker.queueSum = 0;
+    worker.queueSamples = 0;
+    worker.pending.reserve(FLUSH_THRESHOLD);
+    if (epollFd != -1) watchWorker(worker, workers.size() - 1);
+    return worker;
+}
+
+Worker* pickWorker(std::vector<Worker>& workers, RoutingPolicy policy,
+                   unsigned long long totalWeight, Random& random) {
+    if (policy == ROUTE_WEIGHTED) {
+        unsigned long long r = random.next() % totalWeight;
+        for (Worker& worker : workers) {
+            if (r < (unsigned long long)worker.weight) return &worker;
+            r -= worker.weight;
+        }
+    }
+    Worker* best = &workers[0];
+    for (Worker& worker : workers) {
+        if (worker.queued < best->queued) best = &worker;
+    }
+    // Без предзапуска новый ребёнок появляется, только когда у всех уже есть очередь:
+    // короткие задания обходятся одним процессом. Ёмкость вектора зарезервирована, указатели не сдвигаются.
+    if (best->queued >= FLUSH_THRESHOLD && workers.size() < spawnConfig.maxWorkers) {
+        return &startWorker(workers, 1);
+    }
+    return best;
+}
+
+// Сравнение полного времени запуска ребёнка (запуск, exec, EOF на пустом вводе, выход)
+// для fork + exec и posix_spawn. Печатает среднее и перцентили в микросекундах.
+void benchmarkSpawn(int iterations) {
+    const SpawnMethod methods[] = {SPAWN_FORK, SPAWN_POSIX};
+    const char* names[] = {"fork+exec", "posix_spawn"};
+    for (int m = 0; m < 2; ++m) {
+        std::vector<double> samples;
+        for (int i = 0; i < iterations; ++i) {
+            int fds[2];
+            if (pipe2(fds, O_CLOEXEC) == -1) fail("Pipe creation failed\n");
+            double start = nowSeconds();
+            pid_t pid = spawnProcess(methods[m], spawnConfig.path, fds[0], -1, false);
+            close(fds[0]);
+            close(fds[1]);
+            waitpid(pid, NULL, 0);
+            samples.push_back((nowSeconds() - start) * 1e6);
+        }
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (double sample : samples) sum += sample;
+        char msg[192];
+        int msgLen = snprintf(msg, sizeof(msg), "%-12s n=%d mean=%.1f us p50=%.1f us p99=%.1f us max=%.1f us\n",
+                              names[m], iterations, sum / iterations, samples[iterations / 2],
+                              samples[iterations * 99 / 100], samples.back());
+        write(STDOUT_FILENO, msg, msgLen);
+    }
+}
+
+void flushWorker(Worker& worker) {
+    if (worker.pending.empty()) return;
+    if (!writeAll(worker.fd, worker.pending.data(), worker.pending.size())) {
+        fail("Write to child failed\n");
+    }
+    worker.pending.clear();
+}
+
+// Переносит ровно size байт из пайпа source в target
+void spliceExactly(int source, int target, size_t size) {
+    while (size > 0) {
+        ssize_t moved = splice(source, NULL, target, NULL, size, SPLICE_F_MOVE);
+        if (moved <= 0) {
+            if (moved < 0 && errno == EINTR) continue;
+            fail("splice between pipes failed\n");
+        }
+        size -= moved;
+    }
+}
+
+// Последние байты порции, среди которых ищется конец строки
+const size_t PEEK_WINDOW = 4096;
+
+// Раздаёт байты stdin детям порциями через splice, не копируя их в адресное пространство родителя.
+// Порция перекладывается во вспомогательный пайп, tee копирует её в пайп для подсмотра, и из него
+// читаются только последние PEEK_WINDOW байт (остальное уходит в /dev/null без копирования).
+// Ребёнку отдаётся порция до последнего '\n' в этом окне, так что строки не делятся между детьми
+// и их вывод остаётся целыми строками. Строка длиннее окна идёт тому же ребёнку частями,
+// пока не кончится; ребёнок получает её байты подряд, поэтому и символ UTF-8 не разрезается.
+// Возвращает false, если ядро отказалось делать splice до того, как что-то было передано.
+bool forwardZeroCopy(std::vector<Worker>& workers, RoutingPolicy policy,
+                     unsigned long long totalWeight, Random& random) {
+    int staging[2], peek[2];
+    if (pipe2(staging, O_CLOEXEC) == -1 || pipe2(peek, O_CLOEXEC) == -1) {
+        fail("Pipe creation failed\n");
+    }
+    // Хвосты порций оставляют в пайпе неполные страницы, и место кончается раньше байт;
+    // запас буферов делает это реже
+    fcntl(staging[1], F_SETPIPE_SZ, (int)(4 * SPLICE_CHUNK));
+    fcntl(peek[1], F_SETPIPE_SZ, (int)(4 * SPLICE_CHUNK));
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (devNull == -1) fail("Failed to open /dev/null\n");
+
+    char window[PEEK_WINDOW];
+    size_t staged = 0;          // Байт во вспомогательном пайпе
+    Worker* current = NULL;     // Ребёнок, которому принадлежит недоотправленная строка
+    bool started = false, inputEnded = false, supported = true;
+    while (true) {
+        // Пайп stdin пока пуст или вспомогательный пайп забит: ждать нельзя, отдаём то, что есть
+        bool stalled = false;
+        if (!inputEnded && staged < SPLICE_CHUNK) {
+            ssize_t moved = splice(STDIN_FILENO, NULL, staging[1], NULL, SPLICE_CHUNK - staged,
+                                   SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+            if (moved < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN && staged == 0) {
+                    pollfd input = {STDIN_FILENO, POLLIN, 0};
+                    poll(&input, 1, -1);
+                    continue;
+                }
+                if (errno == EAGAIN) {
+                    stalled = true;
+                } else if (!started && (errno == EINVAL || errno == ENOSYS)) {
+                    supported = false;
+                    break;
+                } else {
+                    fail("splice from stdin failed\n");
+                }
+            } else {
+                if (moved == 0) inputEnded = true;
+                staged += moved;
+            }
+        }
+        if (staged == 0) break;
+        started = true;
+
+        ssize_t copied;
+        do {
+            copied = tee(staging[0], peek[1], staged, 0);
+        } while (copied < 0 && errno == EINTR);
+        if (copied <= 0) fail("tee to peek pipe failed\n");
+        size_t length = copied;
+        size_t tail = std::min(length, PEEK_WINDOW);
+        spliceExactly(peek[0], devNull, length - tail);
+        for (size_t got = 0; got < tail;) {
+            ssize_t n = read(peek[0], window + got, tail - got);
+            if (n <= 0) {
+                if (n < 0 && errno == EINTR) continue;
+                fail("Read from peek pipe failed\n");
+            }
+            got += n;
+        }
+        const char* newline = (const char*)memrchr(window, '\n', tail);
+        // Без перевода строки в окне порция уходит целиком, и ребёнок закрепляется за строкой.
+        // Начало строки сперва ждёт продолжения, если tee увидел всё накопленное и ждать можно.
+        size_t cut = newline ? length - tail + (newline - window) + 1 : length;
+        bool canWait = !inputEnded && !stalled && length == staged && length < SPLICE_CHUNK;
+        if (!newline && current == NULL && canWait) continue;
+
+        if (current == NULL) {
+            if (policy == ROUTE_LEAST_LOADED) {
+                for (Worker& worker : workers) {
+                    worker.queued = pipeDepth(worker.fd);
+                }
+            }
+            current = pickWorker(workers, policy, totalWeight, random);
+        }
+        spliceExactly(staging[0], current->fd, cut);
+        current->bytesSent += cut;
+        staged -= cut;
+        if (newline) current = NULL;
+    }
+
+    close(devNull);
+    close(staging[0]);
+    close(staging[1]);
+    close(peek[0]);
+    close(peek[1]);
+    return supported;
+}
+
+// Дублирует каждую порцию stdin всем детям. Порция перекладывается splice во вспомогательный
+// пайп, оттуда tee раздаёт её всем детям, кроме последнего, а последнему она уходит через splice.
+// tee всегда начинает с головы буфера, поэтому если ребёнку досталась только часть порции,
+// хвост берётся из её полной копии в теневом пайпе.
+bool broadcastZeroCopy(std::vector<Worker>& workers) {
+    int staging[2], shadow[2];
+    if (pipe2(staging, O_CLOEXEC) == -1 || pipe2(shadow, O_CLOEXEC) == -1) {
+        fail("Pipe creation failed\n");
+    }
+    int devNull = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (devNull == -1) fail("Failed to open /dev/null\n");
+
+    bool started = false;
+    bool supported = true;
+    while (true) {
+        ssize_t available = splice(STDIN_FILENO, NULL, staging[1], NULL, SPLICE_CHUNK, SPLICE_F_MOVE);
+        if (available < 0) {
+            if (errno == EINTR) continue;
+            if (!started && (errno == EINVAL || errno == ENOSYS)) {
+                supported = false;
+                break;
+            }
+            fail("splice from stdin failed\n");
+        }
+        if (available == 0) break;
+        started = true;
+
+        for (size_t i = 0; i + 1 < workers.size(); ++i) {
+            ssize_t copied;
+            do {
+                copied = tee(staging[0], workers[i].fd, available, 0);
+            } while (copied < 0 && errno == EINTR);
+            if (copied < 0) fail("tee to child failed\n");
+            if (copied < available) {
+                if (tee(staging[0], shadow[1], available, 0) != available) fail("tee to shadow pipe failed\n");
+                spliceExactly(shadow[0], devNull, copied);
+                spliceExactly(shadow[0], workers[i].fd, available - copied);
+            }
+            workers[i].bytesSent += available;
+        }
+        spliceExactly(staging[0], workers.back().fd, available);
+        workers.back().bytesSent += available;
+    }
+
+    close(devNull);
+    close(staging[0]);
+    close(staging[1]);
+    close(shadow[0]);
+    close(shadow[1]);
+    return supported;
+}
+
+// Запасной режим рассылки: каждый прочитанный блок целиком пишется всем детям
+void broadcastCopy(std::vector<Worker>& workers) {
+    std::vector<char> input(READ_CHUNK);
+    while (true) {
+        ssize_t len = read(STDIN_FILENO, input.data(), input.size());
+        if (len < 0) {
+            if (errno == EINTR) continue;
+            fail("Input failed\n");
+        }
+        if (len == 0) break;
+        for (Worker& worker : workers) {
+            if (!writeAll(worker.fd, input.data(), len)) fail("Write to child failed\n");
+            worker.bytesSent += len;
+        }
     }
+}
 
-    // В родительском процессе
-    close(pipe1[0]); // Закрываем конец для чтения pipe1
-    close(pipe2[0]); // Закрываем конец для чтения pipe2
+// Упорядоченный режим: вход режется на кадры по границам строк, кадры нумеруются и раздаются
+// детям, результаты собираются из их пайпов и выводятся строго по номерам. Кольцо на
+// REORDER_WINDOW кадров ограничивает память: новый кадр не отправляется, пока самый старый
+// не выведен.
+struct ReorderBuffer {
+    std::vector<std::vector<char>> slots;
+    std::vector<char> ready;
+    unsigned long long nextSeq;      // Номер следующего отправляемого кадра
+    unsigned long long nextToEmit;   // Номер кадра, который выводится следующим
+    std::vector<char> output;        // Упорядоченный вывод, ещё не записанный в stdout
+};
 
-    // Чтение строки от пользователя
-    char input[1024];
-    ssize_t len = read(STDIN_FILENO, input, sizeof(input) - 1);
-    if (len < 0) {
-        const char* errorMsg = "Input failed\n";
-        write(STDERR_FILENO, errorMsg, strlen(errorMsg));
-        exit(1);
+void flushOutput(ReorderBuffer& reorder) {
+    if (reorder.output.empty()) return;
+    if (!writeAll(STDOUT_FILENO, reorder.output.data(), reorder.output.size())) {
+        fail("Write to stdout failed\n");
     }
+    reorder.output.clear();
+}
 
-    input[len] = '\0';
-    // С вероятностью 80% отправляем строку в pipe1, иначе в pipe2
-    if (rand() % 10 < 8) {
-        write(pipe1[1], input, len);
+void storeResult(ReorderBuffer& reorder, const FrameHeader& header, const char* payload) {
+    if (header.seq == reorder.nextToEmit) {
+        // Самый частый случай: результат пришёл вовремя и сразу уходит в вывод
+        reorder.output.insert(reorder.output.end(), payload, payload + header.length);
+        reorder.nextToEmit++;
     } else {
-        write(pipe2[1], input, len);  //делать проверки
+        size_t slot = header.seq % REORDER_WINDOW;
+        reorder.slots[slot].assign(payload, payload + header.length);
+        reorder.ready[slot] = 1;
+    }
+    while (reorder.ready[reorder.nextToEmit % REORDER_WINDOW]) {
+        size_t slot = reorder.nextToEmit % REORDER_WINDOW;
+        reorder.output.insert(reorder.output.end(), reorder.slots[slot].begin(), reorder.slots[slot].end());
+        reorder.ready[slot] = 0;
+        reorder.nextToEmit++;
+    }
+    if (reorder.output.size() >= FLUSH_THRESHOLD) flushOutput(reorder);
+}
+
+// Неблокирующая дозапись pending; возвращает true, когда всё отправлено
+bool tryFlush(Worker& worker) {
+    while (worker.pendingSent < worker.pending.size()) {
+        ssize_t n = write(worker.fd, worker.pending.data() + worker.pendingSent,
+                          worker.pending.size() - worker.pendingSent);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) {
+                // Отправленное начало буфера убираем, чтобы очередь не росла бесконечно
+                if (worker.pendingSent >= worker.pending.size() / 2) {
+                    worker.pending.erase(worker.pending.begin(), worker.pending.begin() + worker.pendingSent);
+                    worker.pendingSent = 0;
+                }
+                return false;
+            }
+            fail("Write to child failed\n");
+        }
+        worker.pendingSent += n;
+    }
+    worker.pending.clear();
+    worker.pendingSent = 0;
+    return true;
+}
+
+// Читает всё, что ребёнок успел вернуть; при EOF закрывает пайп результатов
+void readResults(Worker& worker, ReorderBuffer& reorder) {
+    if (worker.results.size() < READ_CHUNK) worker.results.resize(READ_CHUNK);
+    while (true) {
+        ssize_t n = read(worker.resultFd, worker.results.data() + worker.resultsLen,
+                         worker.results.size() - worker.resultsLen);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) return;
+            fail("Read from child failed\n");
+        }
+        if (n == 0) {
+            if (worker.resultsLen != 0) fail("Child returned a truncated frame\n");
+            close(worker.resultFd);
+            worker.resultFd = -1;
+            return;
+        }
+        worker.resultsLen += n;
+
+        size_t pos = 0;
+        FrameHeader header;
+        while (peekFrame(worker.results.data() + pos, worker.resultsLen - pos, header)) {
+            storeResult(reorder, header, worker.results.data() + pos + FRAME_HEADER_SIZE);
+            worker.queued -= header.sourceLength;
+            pos += FRAME_HEADER_SIZE + header.length;
+        }
+        memmove(worker.results.data(), worker.results.data() + pos, worker.resultsLen - pos);
+        worker.resultsLen -= pos;
+    }
+}
+
+// Событийный цикл для построчного и упорядоченного режимов. Один epoll следит за stdin,
+// входными пайпами детей (EPOLLOUT, по фронту) и пайпами результатов (EPOLLIN, по фронту).
+// Все записи детям неблокирующие: медленный ребёнок копит очередь в родителе, но не
+// останавливает остальных. Когда выбранному политикой ребёнку некуда класть данные
+// (очередь больше QUEUE_LIMIT или окно упорядочивания заполнено), разбор входа
+// останавливается, входной буфер заполняется и stdin перестаёт читаться.
+size_t unsent(const Worker& worker) {
+    return worker.pending.size() - worker.pendingSent;
+}
+
+// Снимок глубины очередей: байты в пайпе плюс неотправленные из родителя
+void sampleQueues(std::vector<Worker>& workers, bool ordered) {
+    for (Worker& worker : workers) {
+        if (worker.fd == -1) continue;
+        // В упорядоченном режиме очередь — это байты в работе у ребёнка, их учёт ведут кадры
+        if (!ordered) worker.queued = pipeDepth(worker.fd) + unsent(worker);
+        worker.maxQueued = std::max(worker.maxQueued, worker.queued);
+        worker.queueSum += worker.queued;
+        worker.queueSamples++;
     }
+}
+
+struct EventLoopState {
+    RoutingPolicy policy;
+    unsigned long long totalWeight;
+    Random& random;
+    bool ordered;
+    ReorderBuffer reorder;
+    std::vector<char> input;
+    size_t have;                 // Байт во входном буфере
+    bool eof;
+    Worker* current;             // Ребёнок, которому принадлежит недочитанная строка (построчный режим)
+};
+
+// Построчный режим: раздаёт строки из входного буфера, пока выбранному ребёнку есть куда их положить
+size_t routeBufferedLines(std::vector<Worker>& workers, EventLoopState& state) {
+    const char* begin = state.input.data();
+    const char* pos = begin;
+    const char* end = begin + state.have;
+    while (pos < end) {
+        if (state.current == NULL) {
+            state.current = pickWorker(workers, state.policy, state.totalWeight, state.random);
+        }
+        // Выбор сохраняется: строка уйдёт этому ребёнку, когда его очередь разгрузится
+        if (unsent(*state.current) >= QUEUE_LIMIT) break;
+        const char* newline = (const char*)memchr(pos, '\n', end - pos);
+        const char* lineEnd = newline ? newline + 1 : end;
+        state.current->pending.insert(state.current->pending.end(), pos, lineEnd);
+        state.current->queued += lineEnd - pos;
+        state.current->bytesSent += lineEnd - pos;
+        if (newline) {
+            state.current->linesSent++;
+            state.current = NULL;
+        }
+        pos = lineEnd;
+    }
+    if (state.eof && pos == end && state.current != NULL) {
+        state.current->linesSent++; // Последняя строка без перевода строки
+        state.current = NULL;
+    }
+    return pos - begin;
+}
+
+// Упорядоченный режим: вход режется на кадры по frameCut, неполная строка ждёт следующего чтения
+size_t routeBufferedFrames(std::vector<Worker>& workers, EventLoopState& state) {
+    ReorderBuffer& reorder = state.reorder;
+    size_t pos = 0;
+    while (pos < state.have) {
+        if (reorder.nextSeq - reorder.nextToEmit >= REORDER_WINDOW) break;
+        const char* base = state.input.data() + pos;
+        size_t take = frameCut(base, state.have - pos, FRAME_PAYLOAD, state.eof);
+        if (take == 0) break;
+        if (state.current == NULL) {
+            state.current = pickWorker(workers, state.policy, state.totalWeight, state.random);
+        }
+        Worker* worker = state.current;
+        if (unsent(*worker) >= QUEUE_LIMIT) break;
+        state.current = NULL;
+
+        FrameHeader header = {reorder.nextSeq++, (uint32_t)take, (uint32_t)take};
+        const char* headerBytes = (const char*)&header;
+        worker->pending.insert(worker->pending.end(), headerBytes, headerBytes + FRAME_HEADER_SIZE);
+        worker->pending.insert(worker->pending.end(), base, base + take);
+        worker->queued += take;
+        worker->bytesSent += take;
+        worker->linesSent += std::count(base, base + take, '\n');
+        pos += take;
+    }
+    return pos;
+}
+
+void runEventLoop(std::vector<Worker>& workers, RoutingPolicy policy,
+                  unsigned long long totalWeight, Random& random) {
+    EventLoopState state = {policy, totalWeight, random, spawnConfig.ordered, ReorderBuffer(),
+                            std::vector<char>(READ_CHUNK), 0, false, NULL};
+    state.reorder.slots.resize(REORDER_WINDOW);
+    state.reorder.ready.assign(REORDER_WINDOW, 0);
+    state.reorder.nextSeq = 0;
+    state.reorder.nextToEmit = 0;
+
+    // Обычный файл не поддерживает epoll и всегда готов к чтению
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = STDIN_TOKEN;
+    bool stdinPollable = epoll_ctl(epollFd, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0;
+    if (!stdinPollable && errno != EPERM) fail("epoll_ctl failed\n");
+    bool stdinArmed = stdinPollable;
+    bool stdinReady = !stdinPollable;
+    bool inputsClosed = false;
+
+    std::vector<epoll_event> events(64);
+    while (true) {
+        if (stdinReady && !state.eof && state.have < state.input.size()) {
+            ssize_t len = read(STDIN_FILENO, state.input.data() + state.have, state.input.size() - state.have);
+            if (len < 0 && errno != EINTR && errno != EAGAIN) fail("Input failed\n");
+            if (len == 0) state.eof = true;
+            if (len > 0) state.have += len;
+            stdinReady = !stdinPollable;
+        }
+
+        // Раздаём то, что есть во входном буфере, и сразу пытаемся отдать детям
+        sampleQueues(workers, state.ordered);
+        size_t consumed = state.ordered ? routeBufferedFrames(workers, state) : routeBufferedLines(workers, state);
+        memmove(state.input.data(), state.input.data() + consumed, state.have - consumed);
+        state.have -= consumed;
+        for (Worker& worker : workers) {
+            if (worker.fd != -1) tryFlush(worker);
+        }
 
-    close(pipe1[1]); // Закрываем конец для записи pipe1
-    close(pipe2[1]); // Закрываем конец для записи pipe2
+        // Вход кончился и разобран: когда очереди опустеют, закрываем входы детей
+        if (state.eof && state.have == 0 && !inputsClosed) {
+            bool drained = true;
+            for (Worker& worker : workers) drained = drained && unsent(worker) == 0;
+            if (drained) {
+                for (Worker& worker : workers) {
+                    close(worker.fd); // Ребёнок увидит EOF
+                    worker.fd = -1;
+                }
+                inputsClosed = true;
+            }
+        }
+        bool resultsOpen = false;
+        for (Worker& worker : workers) resultsOpen = resultsOpen || worker.resultFd != -1;
+        if (inputsClosed && !resultsOpen) break;
+
+        // Обратное давление: stdin слушаем, только пока во входном буфере есть место
+        bool wantInput = !state.eof && state.have < state.input.size();
+        if (stdinPollable && wantInput != stdinArmed) {
+            event.events = wantInput ? (uint32_t)EPOLLIN : 0u;
+            event.data.u64 = STDIN_TOKEN;
+            epoll_ctl(epollFd, EPOLL_CTL_MOD, STDIN_FILENO, &event);
+            stdinArmed = wantInput;
+        }
+
+        if (state.ordered) flushOutput(state.reorder);
+        int timeout = (!stdinPollable && wantInput) ? 0 : -1;
+        int ready = epoll_wait(epollFd, events.data(), events.size(), timeout);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            fail("epoll_wait failed\n");
+        }
+        for (int k = 0; k < ready; ++k) {
+            uint64_t token = events[k].data.u64;
+            if (token == STDIN_TOKEN) {
+                stdinReady = true;
+                continue;
+            }
+            Worker& worker = workers[token / 2];
+            if (token % 2 == 1) {
+                if (worker.resultFd != -1) readResults(worker, state.reorder);
+            } else if (worker.fd != -1) {
+                tryFlush(worker);
+            }
+        }
+    }
+
+    if (stdinPollable) epoll_ctl(epollFd, EPOLL_CTL_DEL, STDIN_FILENO, NULL);
+    if (state.ordered) {
+        if (state.reorder.nextToEmit != state.reorder.nextSeq) fail("Some frames were not returned by children\n");
+        flushOutput(state.reorder);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // По умолчанию по ребёнку на ядро и маршрутизация по глубине очереди
+    long workerCount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workerCount < 1) workerCount = 1;
+    RoutingPolicy policy = ROUTE_LEAST_LOADED;
+    std::vector<int> weights;
+    Random random = {0x9E3779B97F4A7C15ULL};
+    bool printStats = false;
+    bool zeroCopy = false;
+    bool broadcast = false;
+    bool threads = false;
+    std::vector<std::string> stages;
+    size_t pipeSize = 1 << 20;
+    const char* workerPath = NULL;
+    int spawnBenchIterations = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+            workerCount = strtol(argv[++i], NULL, 10);
+            if (workerCount < 1) fail("Invalid --workers, expected a positive number\n");
+        } else if (strcmp(argv[i], "--weights") == 0 && i + 1 < argc) {
+            if (!parseWeights(argv[++i], weights)) fail("Invalid --weights, expected e.g. 80,20\n");
+            policy = ROUTE_WEIGHTED;
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "least-loaded") == 0) {
+                policy = ROUTE_LEAST_LOADED;
+            } else if (strcmp(argv[i], "weighted") == 0) {
+                policy = ROUTE_WEIGHTED;
+            } else {
+                fail("Invalid --policy, expected least-loaded or weighted\n");
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            random.state = strtoull(argv[++i], NULL, 10) | 1;
+        } else if (strcmp(argv[i], "--zero-copy") == 0) {
+            zeroCopy = true;
+        } else if (strcmp(argv[i], "--broadcast") == 0) {
+            broadcast = true;
+        } else if (strcmp(argv[i], "--spawn") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "posix") == 0) {
+                spawnConfig.method = SPAWN_POSIX;
+            } else if (strcmp(argv[i], "fork") == 0) {
+                spawnConfig.method = SPAWN_FORK;
+            } else {
+                fail("Invalid --spawn, expected posix or fork\n");
+            }
+        } else if (strcmp(argv[i], "--stage") == 0 && i + 1 < argc) {
+            stages.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--pipe-size") == 0 && i + 1 < argc) {
+            long size = strtol(argv[++i], NULL, 10);
+            if (size < 4096) fail("Invalid --pipe-size, expected at least 4096 bytes\n");
+            pipeSize = size;
+        } else if (strcmp(argv[i], "--threads") == 0) {
+            threads = true;
+        } else if (strcmp(argv[i], "--ordered") == 0) {
+            spawnConfig.ordered = true;
+        } else if (strcmp(argv[i], "--utf8") == 0) {
+            spawnConfig.utf8 = true;
+        } else if (strcmp(argv[i], "--prefork") == 0) {
+            spawnConfig.prefork = true;
+        } else if (strcmp(argv[i], "--worker-path") == 0 && i + 1 < argc) {
+            workerPath = argv[++i];
+        } else if (strcmp(argv[i], "--spawn-bench") == 0 && i + 1 < argc) {
+            spawnBenchIterations = atoi(argv[++i]);
+            if (spawnBenchIterations < 1) fail("Invalid --spawn-bench, expected a positive number\n");
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            printStats = true;
+        } else {
+            fail("Usage: 1laba [--workers N] [--policy least-loaded|weighted] [--weights A,B,...] "
+                 "[--seed N] [--zero-copy] [--broadcast] [--ordered] [--utf8] [--threads] [--spawn posix|fork] [--prefork] "
+                 "[--worker-path PATH] [--spawn-bench N] [--stats]\n"
+                 "       1laba --stage CMD [--stage CMD ...] [--pipe-size BYTES] [--utf8] [--stats]\n"
+                 "  CMD: remove_vowels [OPTIONS], lowercase, dedupe or any program from PATH with arguments\n");
+        }
+    }
+
+    // Веса задают и количество детей; без них взвешенный режим делит 80/20 между двумя
+    if (policy == ROUTE_WEIGHTED) {
+        if (weights.empty()) {
+            weights.push_back(80);
+            weights.push_back(20);
+        }
+        workerCount = weights.size();
+    }
+    if (spawnConfig.ordered && (zeroCopy || broadcast)) {
+        fail("--ordered cannot be combined with --zero-copy or --broadcast\n");
+    }
+    // Конвейер стадий: каждая стадия - отдельный процесс, пула детей нет
+    if (!stages.empty()) {
+        if (threads || zeroCopy || broadcast || spawnConfig.ordered || spawnBenchIterations > 0) {
+            fail("--stage cannot be combined with other parent modes\n");
+        }
+        bool needsWorker = false;
+        for (const std::string& stage : stages) needsWorker = needsWorker || isWorkerStage(stage);
+        StageConfig config = {stages, needsWorker ? resolveWorkerPath(workerPath) : "", pipeSize,
+                              spawnConfig.utf8, printStats};
+        signal(SIGPIPE, SIG_IGN);
+        return runStagePipeline(config);
+    }
+
+    // Потоковый режим: те же маршрутизация и порядок вывода, но фильтры - потоки этого процесса
+    if (threads) {
+        if (zeroCopy || broadcast || spawnBenchIterations > 0) {
+            fail("--threads cannot be combined with --zero-copy, --broadcast or --spawn-bench\n");
+        }
+        ThreadModeConfig config = {(size_t)workerCount, policy == ROUTE_WEIGHTED ? weights : std::vector<int>(),
+                                   random, spawnConfig.ordered, spawnConfig.utf8, printStats};
+        runThreadMode(config);
+        return 0;
+    }
+    spawnConfig.path = resolveWorkerPath(workerPath);
+    spawnConfig.maxWorkers = workerCount;
+
+    // Ошибку записи в умершего ребёнка обрабатываем сами, а не падаем по SIGPIPE
+    signal(SIGPIPE, SIG_IGN);
+
+    if (spawnBenchIterations > 0) {
+        benchmarkSpawn(spawnBenchIterations);
+        return 0;
+    }
+
+    // Веса и рассылка нужны сразу всем детям, поэтому в этих режимах пул всегда предзапускается;
+    // иначе до чтения входа запускается один ребёнок, остальные по мере роста очередей
+    double start = nowSeconds();
+    std::vector<Worker> workers;
+    workers.reserve(workerCount);
+    bool prefork = spawnConfig.prefork || policy == ROUTE_WEIGHTED || broadcast;
+    unsigned long long totalWeight = 0;
+    for (size_t i = 0; i < (prefork ? (size_t)workerCount : 1); ++i) {
+        int weight = weights.empty() ? 1 : weights[i];
+        startWorker(workers, weight);
+        totalWeight += weight;
+    }
+    double poolReady = nowSeconds() - start;
+
+    bool done = false;
+    if (zeroCopy) {
+        done = broadcast ? broadcastZeroCopy(workers) : forwardZeroCopy(workers, policy, totalWeight, random);
+        if (!done) {
+            const char* msg = "splice is not supported for this input, falling back to read/write\n";
+            write(STDERR_FILENO, msg, strlen(msg));
+        }
+    }
+    if (!done) {
+        if (broadcast) {
+            broadcastCopy(workers);
+        } else {
+            // Построчный и упорядоченный режимы работают в событийном цикле; уже запущенные
+            // дети ставятся под epoll здесь, новые регистрируются при запуске
+            epollFd = epoll_create1(EPOLL_CLOEXEC);
+            if (epollFd == -1) fail("epoll_create1 failed\n");
+            for (size_t i = 0; i < workers.size(); ++i) {
+                watchWorker(workers[i], i);
+            }
+            runEventLoop(workers, policy, totalWeight, random);
+            close(epollFd);
+            epollFd = -1;
+        }
+    }
+
+    for (Worker& worker : workers) {
+        if (worker.fd == -1) continue; // Событийный цикл закрывает входы сам
+        flushWorker(worker);
+        close(worker.fd); // Ребёнок увидит EOF
+    }
 
     // Ожидание завершения дочерних процессов
-    wait(NULL);
-    wait(NULL);
+    for (Worker& worker : workers) {
+        waitpid(worker.pid, NULL, 0);
+    }
+
+    if (printStats) {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            char msg[160];
+            const Worker& worker = workers[i];
+            int msgLen = snprintf(msg, sizeof(msg), "child %zu: %llu lines, %llu bytes, queue max %llu B, avg %llu B\n",
+                                  i + 1, worker.linesSent, worker.bytesSent, worker.maxQueued,
+                                  worker.queueSamples ? worker.queueSum / worker.queueSamples : 0);
+            write(STDERR_FILENO, msg, msgLen);
+        }
+        // Время процессора самого родителя показывает цену копирования через пользовательское пространство
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        char msg[160];
+        int msgLen = snprintf(msg, sizeof(msg), "parent: %s, wall %.3f s, user %.3f s, sys %.3f s\n",
+                              done ? "zero-copy" : spawnConfig.ordered ? "ordered" : "read/write", nowSeconds() - start,
+                              usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+                              usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6);
+        write(STDERR_FILENO, msg, msgLen);
+        msgLen = snprintf(msg, sizeof(msg), "spawn: %s, %llu workers, pool ready in %.1f us, avg %.1f us, max %.1f us\n",
+                          spawnConfig.method == SPAWN_POSIX ? "posix_spawn" : "fork+exec", spawnConfig.spawned,
+                          poolReady * 1e6, spawnConfig.spawnSeconds / spawnConfig.spawned * 1e6,
+                          spawnConfig.maxSpawnSeconds * 1e6);
+        write(STDERR_FILENO, msg, msgLen);
+    }
 
     return 0;
 }
@@ -0,0 +1,344 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include <spawn.h>
+#include <climits>
+#include <ctime>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "parent_common.h"
+
+extern char** environ;
+
+// Замер конвейера 1laba + remove_vowels: пропускная способность и задержка отдельных строк.
+//
+// Каждая строка синтетического корпуса начинается с номера и табуляции ("123\t..."): цифры
+// и табуляция не гласные, поэтому номер доходит до вывода нетронутым. Время строки — от момента,
+// когда её последний байт принят пайпом 1laba, до момента, когда её перевод строки прочитан из вывода.
+// Строки, номер которых не удалось разобрать или которые не пришли вовсе, считаются в столбце
+// unmatched. Дети пишут в общий stdout только целыми строками, так что перемежаться могут лишь
+// строки длиннее PIPE_BUF (корпус long): запись такой длины в пайп не атомарна.
+
+// Порция записи на вход 1laba и чтения его вывода
+const size_t IO_CHUNK = 64 * 1024;
+
+// Текст корпуса и смещения за концом каждой строки
+struct Corpus {
+    std::string name;
+    bool utf8;
+    std::vector<char> data;
+    std::vector<size_t> lineEnds;
+};
+
+struct Options {
+    std::string label;
+    std::string laba;
+    std::string worker;
+    size_t corpusBytes;
+    std::vector<std::string> corpora;
+    std::vector<int> workerCounts;
+    std::vector<std::string> policies;
+    std::vector<bool> modes; // false - обычный, true - --ordered
+    std::vector<bool> execs; // false - дети-процессы, true - --threads
+};
+
+// Результат одного прогона
+struct RunResult {
+    double seconds;
+    size_t unmatched;              // Строки, для которых задержку измерить не удалось
+    std::vector<double> latencies; // В секундах, по одной на сопоставленную строку
+};
+
+const char* const LATIN_WORDS[] = {"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog", "pipe",
+                                   "process", "vowel", "kernel", "stream", "buffer", "worker", "a", "I"};
+const char* const CYRILLIC_WORDS[] = {"съешь", "же", "ещё", "этих", "мягких", "французских", "булок", "да",
+                                      "выпей", "чаю", "Ёжик", "ЮЛА", "и", "процесс", "канал", "гласные"};
+
+void appendWord(std::vector<char>& data, const char* word) {
+    data.insert(data.end(), word, word + strlen(word));
+}
+
+// Корпуса: ascii - строки по 60-100 байт английских слов, cyrillic - те же строки по-русски
+// с вкраплениями латиницы, long - строки по 256 КиБ, tiny - строки из 1-8 букв
+Corpus makeCorpus(const std::string& kind, size_t size, Random& random) {
+    Corpus corpus = {kind, kind == "cyrillic", std::vector<char>(), std::vector<size_t>()};
+    corpus.data.reserve(size + (256 << 10) + 64);
+    const size_t latinCount = sizeof(LATIN_WORDS) / sizeof(LATIN_WORDS[0]);
+    const size_t cyrillicCount = sizeof(CYRILLIC_WORDS) / sizeof(CYRILLIC_WORDS[0]);
+    while (corpus.data.size() < size) {
+        char id[32];
+        int idLen = snprintf(id, sizeof(id), "%zu\t", corpus.lineEnds.size());
+        corpus.data.insert(corpus.data.end(), id, id + idLen);
+        size_t lineStart = corpus.data.size();
+        if (kind == "tiny") {
+            size_t letters = 1 + random.below(8);
+            for (size_t i = 0; i < letters; ++i) corpus.data.push_back((char)('a' + random.below(26)));
+        } else {
+            size_t target = kind == "long" ? (256 << 10) : 60 + random.below(41);
+            while (corpus.data.size() - lineStart < target) {
+                if (corpus.data.size() != lineStart) corpus.data.push_back(' ');
+                bool latin = kind != "cyrillic" || random.below(5) == 0;
+                appendWord(corpus.data, latin ? LATIN_WORDS[random.below(latinCount)]
+                                              : CYRILLIC_WORDS[random.below(cyrillicCount)]);
+            }
+        }
+        corpus.data.push_back('\n');
+        corpus.lineEnds.push_back(corpus.data.size());
+    }
+    return corpus;
+}
+
+// Номер строки из её начала "123\t"; false, если начало не похоже на номер
+bool parseLineId(const std::string& head, size_t& id) {
+    size_t digits = 0;
+    id = 0;
+    while (digits < head.size() && head[digits] >= '0' && head[digits] <= '9' && digits < 19) {
+        id = id * 10 + (head[digits] - '0');
+        ++digits;
+    }
+    return digits > 0 && digits < head.size() && head[digits] == '\t';
+}
+
+// Запускает 1laba с перенаправленными stdin/stdout и гонит через него корпус
+RunResult runPipeline(const Options& options, const Corpus& corpus, int workers, const std::string& policy,
+                      bool ordered, bool threads) {
+    std::vector<std::string> args = {"1laba", "--worker-path", options.worker, "--policy", policy};
+    if (policy == "weighted") {
+        // Веса workers, workers-1, ..., 1 задают и количество детей
+        std::string weights;
+        for (int w = workers; w >= 1; --w) weights += std::to_string(w) + (w > 1 ? "," : "");
+        args.push_back("--weights");
+        args.push_back(weights);
+    } else {
+        args.push_back("--workers");
+        args.push_back(std::to_string(workers));
+    }
+    if (ordered) args.push_back("--ordered");
+    if (threads) args.push_back("--threads");
+    if (corpus.utf8) args.push_back("--utf8");
+    std::vector<char*> argv;
+    for (std::string& arg : args) argv.push_back((char*)arg.c_str());
+    argv.push_back(NULL);
+
+    int input[2], output[2];
+    if (pipe2(input, O_CLOEXEC) == -1 || pipe2(output, O_CLOEXEC) == -1) {
+        fail("Pipe creation failed\n");
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, input[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, output[1], STDOUT_FILENO);
+
+    RunResult result = {0.0, 0, std::vector<double>()};
+    result.latencies.reserve(corpus.lineEnds.size());
+    std::vector<double> sentAt(corpus.lineEnds.size(), 0.0);
+    std::vector<bool> received(corpus.lineEnds.size(), false);
+
+    double start = nowSeconds();
+    pid_t child;
+    if (posix_spawn(&child, options.laba.c_str(), &actions, NULL, argv.data(), environ) != 0) {
+        fail("posix_spawn failed\n");
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    close(input[0]);
+    close(output[1]);
+    fcntl(input[1], F_SETFL, O_NONBLOCK);
+
+    std::vector<char> buffer(IO_CHUNK);
+    std::string head; // Начало текущей строки вывода, не длиннее номера
+    size_t written = 0, nextSent = 0;
+    int inputFd = input[1];
+    while (true) {
+        pollfd fds[2] = {{output[0], POLLIN, 0}, {inputFd, POLLOUT, 0}};
+        if (poll(fds, inputFd != -1 ? 2 : 1, -1) == -1) {
+            if (errno == EINTR) continue;
+            fail("poll failed\n");
+        }
+        if (inputFd != -1 && fds[1].revents) {
+            ssize_t n = write(inputFd, corpus.data.data() + written, std::min(IO_CHUNK, corpus.data.size() - written));
+            if (n < 0 && errno != EAGAIN && errno != EINTR) fail("Write to 1laba failed\n");
+            if (n > 0) {
+                written += n;
+                double now = nowSeconds();
+                while (nextSent < corpus.lineEnds.size() && corpus.lineEnds[nextSent] <= written) {
+                    sentAt[nextSent++] = now;
+                }
+                if (written == corpus.data.size()) {
+                    close(inputFd); // 1laba увидит EOF
+                    inputFd = -1;
+                }
+            }
+        }
+        if (fds[0].revents) {
+            ssize_t n = read(output[0], buffer.data(), buffer.size());
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fail("Read from 1laba failed\n");
+            }
+            if (n == 0) break;
+            double now = nowSeconds();
+            for (ssize_t i = 0; i < n; ++i) {
+                char c = buffer[i];
+                if (c != '\n') {
+                    if (head.size() < 24) head.push_back(c);
+                    continue;
+                }
+                size_t id;
+                if (parseLineId(head, id) && id < nextSent && !received[id]) {
+                    received[id] = true;
+                    result.latencies.push_back(now - sentAt[id]);
+                }
+                head.clear();
+            }
+        }
+    }
+    close(output[0]);
+    int status;
+    waitpid(child, &status, 0);
+    result.seconds = nowSeconds() - start;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) fail("1laba exited with an error\n");
+    if (inputFd != -1) fail("1laba closed its output before reading all input\n");
+
+    result.unmatched = corpus.lineEnds.size() - result.latencies.size();
+    return result;
+}
+
+// Квантиль q отсортированных задержек в микросекундах
+double percentileMicros(const std::vector<double>& sorted, double q) {
+    if (sorted.empty()) return 0.0;
+    size_t index = std::min(sorted.size() - 1, (size_t)(q * sorted.size()));
+    return sorted[index] * 1e6;
+}
+
+template <typename T, typename Parse>
+bool parseList(const char* text, std::vector<T>& values, Parse parse) {
+    values.clear();
+    std::string item;
+    for (const char* p = text;; ++p) {
+        if (*p == ',' || *p == '\0') {
+            T value;
+            if (item.empty() || !parse(item, value)) return false;
+            values.push_back(value);
+            item.clear();
+            if (*p == '\0') break;
+        } else {
+            item.push_back(*p);
+        }
+    }
+    return true;
+}
+
+// Каталог, в котором лежит сам bench_pipeline: по умолчанию 1laba и remove_vowels ищутся рядом
+std::string selfDirectory() {
+    char self[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len <= 0) return "./";
+    self[len] = '\0';
+    std::string path(self);
+    return path.substr(0, path.rfind('/') + 1);
+}
+
+int main(int argc, char* argv[]) {
+    std::string dir = selfDirectory();
+    Options options = {"current", dir + "1laba", dir + "remove_vowels", 32 << 20,
+                       {"ascii", "cyrillic", "long", "tiny"}, {1, 2, 4}, {"least-loaded", "weighted"},
+                       {false, true}, {false, true}};
+    const char* csvPath = NULL;
+    const char* usage = "Usage: bench_pipeline [--label NAME] [--laba PATH] [--worker PATH] [--size MB] "
+                        "[--corpus ascii,cyrillic,long,tiny] [--workers 1,2,4] [--policy least-loaded,weighted] "
+                        "[--mode plain,ordered] [--exec process,threads] [--csv FILE]\n";
+    for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--label") == 0 && hasValue) {
+            options.label = argv[++i];
+        } else if (strcmp(argv[i], "--laba") == 0 && hasValue) {
+            options.laba = argv[++i];
+        } else if (strcmp(argv[i], "--worker") == 0 && hasValue) {
+            options.worker = argv[++i];
+        } else if (strcmp(argv[i], "--size") == 0 && hasValue) {
+            long mb = strtol(argv[++i], NULL, 10);
+            if (mb <= 0) fail("Invalid --size\n");
+            options.corpusBytes = (size_t)mb << 20;
+        } else if (strcmp(argv[i], "--corpus") == 0 && hasValue) {
+            bool ok = parseList(argv[++i], options.corpora, [](const std::string& item, std::string& value) {
+                value = item;
+                return item == "ascii" || item == "cyrillic" || item == "long" || item == "tiny";
+            });
+            if (!ok) fail("Invalid --corpus\n");
+        } else if (strcmp(argv[i], "--workers") == 0 && hasValue) {
+            bool ok = parseList(argv[++i], options.workerCounts, [](const std::string& item, int& value) {
+                value = atoi(item.c_str());
+                return value > 0;
+            });
+            if (!ok) fail("Invalid --workers\n");
+        } else if (strcmp(argv[i], "--policy") == 0 && hasValue) {
+            bool ok = parseList(argv[++i], options.policies, [](const std::string& item, std::string& value) {
+                value = item;
+                return item == "least-loaded" || item == "weighted";
+            });
+            if (!ok) fail("Invalid --policy\n");
+        } else if (strcmp(argv[i], "--mode") == 0 && hasValue) {
+            std::vector<std::string> modes;
+            bool ok = parseList(argv[++i], modes, [](const std::string& item, std::string& value) {
+                value = item;
+                return item == "plain" || item == "ordered";
+            });
+            if (!ok) fail("Invalid --mode\n");
+            options.modes.clear();
+            for (const std::string& mode : modes) options.modes.push_back(mode == "ordered");
+        } else if (strcmp(argv[i], "--exec") == 0 && hasValue) {
+            std::vector<std::string> execs;
+            bool ok = parseList(argv[++i], execs, [](const std::string& item, std::string& value) {
+                value = item;
+                return item == "process" || item == "threads";
+            });
+            if (!ok) fail("Invalid --exec\n");
+            options.execs.clear();
+            for (const std::string& exec : execs) options.execs.push_back(exec == "threads");
+        } else if (strcmp(argv[i], "--csv") == 0 && hasValue) {
+            csvPath = argv[++i];
+        } else {
+            fail(usage);
+        }
+    }
+    if (access(options.laba.c_str(), X_OK) != 0 || access(options.worker.c_str(), X_OK) != 0) {
+        fail("1laba or remove_vowels not found, pass --laba and --worker\n");
+    }
+
+    FILE* csv = csvPath ? fopen(csvPath, "w") : stdout;
+    if (csv == NULL) fail("Cannot open CSV file\n");
+    fprintf(csv, "label,corpus,exec,workers,policy,mode,bytes,lines,seconds,mb_per_s,lines_per_s,"
+                 "p50_us,p99_us,p999_us,unmatched\n");
+
+    Random random = {0x9E3779B97F4A7C15ULL};
+    for (const std::string& kind : options.corpora) {
+        Corpus corpus = makeCorpus(kind, options.corpusBytes, random);
+        for (int workers : options.workerCounts) {
+            for (const std::string& policy : options.policies) {
+                for (bool ordered : options.modes) {
+                    for (bool threads : options.execs) {
+                        RunResult run = runPipeline(options, corpus, workers, policy, ordered, threads);
+                        std::sort(run.latencies.begin(), run.latencies.end());
+                        fprintf(csv, "%s,%s,%s,%d,%s,%s,%zu,%zu,%.3f,%.1f,%.0f,%.1f,%.1f,%.1f,%zu\n",
+                                options.label.c_str(), kind.c_str(), threads ? "threads" : "process", workers,
+                                policy.c_str(), ordered ? "ordered" : "plain", corpus.data.size(),
+                                corpus.lineEnds.size(), run.seconds, corpus.data.size() / run.seconds / 1e6,
+                                corpus.lineEnds.size() / run.seconds, percentileMicros(run.latencies, 0.50),
+                                percentileMicros(run.latencies, 0.99), percentileMicros(run.latencies, 0.999),
+                                run.unmatched);
+                        fflush(csv);
+                    }
+                }
+            }
+        }
+    }
+    if (csv != stdout) fclose(csv);
+    return 0;
+}
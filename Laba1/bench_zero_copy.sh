@@ -0,0 +1,48 @@
+#!/usr/bin/env bash
+# Сравнение режима read/write и режима без копирования (splice/tee) родителя 1laba.cpp.
+#
+# Использование: ./bench_zero_copy.sh [размер_в_ГБ] [детей]
+# Программы собираются целями CMake в каталоге BENCH_BUILD (по умолчанию вне дерева
+# исходников, в $TMPDIR/laba1_bench_build). Входной файл генерируется там же один раз,
+# каждый режим прогоняется и с файлом, и с пайпом на stdin. Вывод детей уходит
+# в /dev/null, поэтому в числах видна стоимость доставки данных детям, а не вывода.
+set -euo pipefail
+
+SIZE_GB=${1:-2}
+WORKERS=${2:-2}
+DIR="$(cd "$(dirname "$0")" && pwd)"
+BUILD="${BENCH_BUILD:-${TMPDIR:-/tmp}/laba1_bench_build}"
+INPUT="$BUILD/input_${SIZE_GB}g.txt"
+
+cmake -S "$DIR" -B "$BUILD" -DCMAKE_BUILD_TYPE=Release > /dev/null
+cmake --build "$BUILD" --target 1laba remove_vowels > /dev/null
+cd "$BUILD"
+
+if [ ! -f "$INPUT" ]; then
+    echo "Генерация $SIZE_GB ГБ входных данных..."
+    # Текст из строк по 76 символов, как у base64
+    head -c $((SIZE_GB * 1024 * 1024 * 1024 * 3 / 4)) /dev/urandom | base64 > "$INPUT"
+fi
+BYTES=$(stat -c %s "$INPUT")
+
+run() {
+    local label=$1 source=$2
+    shift 2
+    local start end stats
+    start=$(date +%s.%N)
+    if [ "$source" = file ]; then
+        stats=$(./1laba --workers "$WORKERS" --stats "$@" < "$INPUT" 2>&1 >/dev/null)
+    else
+        stats=$(cat "$INPUT" | ./1laba --workers "$WORKERS" --stats "$@" 2>&1 >/dev/null)
+    fi
+    end=$(date +%s.%N)
+    echo "$label ($source): $(awk -v b="$BYTES" -v s="$start" -v e="$end" 'BEGIN { printf "%.1f", b / (e - s) / 1e6 }') MB/s; $(echo "$stats" | grep '^parent')"
+}
+
+echo "Вход: $BYTES байт, детей: $WORKERS"
+for source in file pipe; do
+    run "read/write" $source
+    run "zero-copy " $source --zero-copy
+    run "broadcast read/write" $source --broadcast
+    run "broadcast zero-copy " $source --broadcast --zero-copy
+done
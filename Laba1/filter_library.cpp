@@ -0,0 +1,113 @@
+#include <unistd.h>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+
+#include "filter_library.h"
+
+bool buildFilter(Filter& filter, const char* dropSpec, const char* keepSpec, bool utf8) {
+    filter.kernel = vf_select_kernel();
+    filter.set = Vowels::value;
+    filter.utf8 = utf8;
+    if (dropSpec == NULL && keepSpec == NULL) return true;
+    return vf_charset_build(&filter.set, dropSpec, keepSpec) == 0;
+}
+
+size_t filterBlock(const Filter& filter, const char* in, size_t len, char* out) {
+    size_t consumed;
+    size_t kept = filter.apply(in, len, out, consumed);
+    memcpy(out + kept, in + consumed, len - consumed);
+    return kept + len - consumed;
+}
+
+void filterBatch(const Filter& filter, FilterBuffer* buffers, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        // Пока фильтруется текущий блок, начало следующего подтягивается в кэш
+        if (i + 1 < count) __builtin_prefetch(buffers[i + 1].input);
+        buffers[i].outputLength = filterBlock(filter, buffers[i].input, buffers[i].length, buffers[i].output);
+    }
+}
+
+// Режим UTF-8: текст, порезанный на блоки любого размера с переносом оборванных
+// последовательностей, должен дать тот же результат, что и скалярное ядро на всём тексте сразу
+static bool checkUtf8Chunks(vf_kernel_fn fn) {
+    const char* words[] = {"Привет, ", "мир", "! ", "ЁЖИК ", "ёлка", " hello ", "World", "\n", "\xd0", "\xff", "ß", "€", "😀"};
+    static char text[8192];
+    static char expected[8192];
+    static char actual[8192];
+    static char block[8192 + 4];
+    size_t len = 0;
+    srand(54321);
+    while (true) {
+        const char* word = words[rand() % (sizeof(words) / sizeof(words[0]))];
+        size_t n = strlen(word);
+        if (len + n > sizeof(text)) break;
+        memcpy(text + len, word, n);
+        len += n;
+    }
+
+    size_t consumed;
+    size_t want = vf_filter_utf8(vf_filter_scalar, &Vowels::value, text, len, expected, &consumed);
+    want += len - consumed;
+    memcpy(expected + want - (len - consumed), text + consumed, len - consumed);
+    for (size_t chunk = 1; chunk <= 200; ++chunk) {
+        size_t got = 0, carry = 0;
+        for (size_t pos = 0; pos < len; pos += chunk) {
+            size_t n = std::min(chunk, len - pos);
+            memcpy(block + carry, text + pos, n);
+            got += vf_filter_utf8(fn, &Vowels::value, block, carry + n, actual + got, &consumed);
+            carry = carry + n - consumed;
+            memmove(block, block + consumed, carry);
+        }
+        memcpy(actual + got, block, carry);
+        got += carry;
+        if (got != want || memcmp(expected, actual, want) != 0) return false;
+    }
+    return true;
+}
+
+// Ядра сверяются со скалярным на случайных данных разной длины и с разным смещением, на множестве гласных и на случайных множествах, включая байты >= 0x80
+bool selfCheckKernels() {
+    const size_t maxLen = 4096 + 200;
+    static char sample[maxLen + 64];
+    static char expected[maxLen + 64];
+    static char actual[maxLen + 64];
+
+    // Смесь текста с гласными в обоих регистрах и произвольных байт, включая >= 0x80
+    const char alphabet[] = "aeiouAEIOUbcdxyzBCDXYZ \n.,0123456789\x80\xff\x40\x60\x21";
+    srand(12345);
+    for (size_t i = 0; i < sizeof(sample); ++i) {
+        sample[i] = (i % 7 == 0) ? (char)(rand() & 0xFF) : alphabet[rand() % (sizeof(alphabet) - 1)];
+    }
+
+    const int setCount = 6;
+    vf_charset sets[setCount];
+    sets[0] = Vowels::value;
+    for (int s = 1; s < setCount; ++s) {
+        for (int c = 0; c < 256; ++c) sets[s].drop[c] = rand() % (s + 1) == 0;
+        vf_charset_finish(&sets[s]);
+    }
+
+    vf_kernel kernels[8];
+    size_t count = vf_available_kernels(kernels, 8);
+    bool ok = true;
+    for (size_t k = 1; k < count; ++k) {
+        size_t failures = 0;
+        for (int s = 0; s < setCount; ++s) {
+            for (size_t offset = 0; offset < 64; ++offset) {
+                for (size_t len = 0; len <= maxLen; len += (len < 300 ? 1 : 97)) {
+                    size_t want = vf_filter_scalar(&sets[s], sample + offset, len, expected);
+                    size_t got = kernels[k].fn(&sets[s], sample + offset, len, actual);
+                    if (got != want || memcmp(expected, actual, want) != 0) ++failures;
+                }
+            }
+        }
+        failures += checkUtf8Chunks(kernels[k].fn) ? 0 : 1;
+        char msg[128];
+        int msgLen = snprintf(msg, sizeof(msg), "%s: %s\n", kernels[k].name, failures ? "MISMATCH" : "ok");
+        write(STDERR_FILENO, msg, msgLen);
+        ok = ok && failures == 0;
+    }
+    return ok;
+}
@@ -0,0 +1,66 @@
+#ifndef FILTER_LIBRARY_H
+#define FILTER_LIBRARY_H
+
+#include <cstddef>
+
+#include "../common/vowel_filter.h"
+
+// Фильтр удаления символов без ввода-вывода: общий для процесса remove_vowels
+// и потоков 1laba --threads.
+
+// Множество удаляемых байт, построенное компилятором из описания: разбор описания
+// выполняется в constexpr, в бинарник попадает готовая таблица на 256 байт
+constexpr vf_charset compileCharset(const char* spec) {
+    vf_charset set{};
+    if (vf_charset_build(&set, spec, nullptr) != 0) throw "invalid charset spec";
+    return set;
+}
+
+template <const char* Spec>
+struct CompiledCharset {
+    static constexpr vf_charset value = compileCharset(Spec);
+};
+
+constexpr char VOWELS_SPEC[] = VF_VOWELS_SPEC;
+using Vowels = CompiledCharset<VOWELS_SPEC>;
+
+static_assert(Vowels::value.drop['a'] && Vowels::value.drop['U'] && !Vowels::value.drop['b'] &&
+              !Vowels::value.drop['\n'], "vowel table must drop exactly AEIOUaeiou");
+
+// Ядро и множество, с которыми работает фильтр. В режиме UTF-8 (--utf8) удаляются и гласные
+// кириллицы, а consumed может оказаться меньше len, если блок оборвал многобайтовую последовательность
+struct Filter {
+    vf_kernel kernel;
+    vf_charset set;
+    bool utf8;
+
+    size_t apply(const char* in, size_t len, char* out, size_t& consumed) const {
+        if (utf8) return vf_filter_utf8(kernel.fn, &set, in, len, out, &consumed);
+        consumed = len;
+        return kernel.fn(&set, in, len, out);
+    }
+};
+
+// Строит фильтр с лучшим ядром: без описаний множество гласных, собранное при компиляции,
+// иначе заданные множества разбираются тем же кодом при запуске. false при ошибке в описании.
+bool buildFilter(Filter& filter, const char* dropSpec, const char* keepSpec, bool utf8);
+
+// Фильтрует самостоятельный блок: последовательность UTF-8, оборванная его концом,
+// переносится как есть. out должен вмещать len байт; возвращает длину результата.
+size_t filterBlock(const Filter& filter, const char* in, size_t len, char* out);
+
+// Один буфер пакетного вызова: output должен вмещать length байт, outputLength заполняет фильтр
+struct FilterBuffer {
+    const char* input;
+    size_t length;
+    char* output;
+    size_t outputLength;
+};
+
+// Пакетный вызов: фильтрует count самостоятельных блоков за одно обращение к библиотеке
+void filterBatch(const Filter& filter, FilterBuffer* buffers, size_t count);
+
+// Сверяет каждое доступное векторное ядро со скалярным; печатает результат в stderr
+bool selfCheckKernels();
+
+#endif // FILTER_LIBRARY_H
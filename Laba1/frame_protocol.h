@@ -0,0 +1,44 @@
+#ifndef FRAME_PROTOCOL_H
+#define FRAME_PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// Кадр упорядоченного режима между 1laba и remove_vowels --framed: заголовок и length байт данных.
+// Родитель нумерует кадры по порядку входа, ребёнок возвращает результат с тем же seq,
+// а в sourceLength сообщает длину исходного кадра, чтобы родитель знал, сколько байт у него в работе.
+// Обе стороны работают на одной машине, поэтому поля пишутся в родном порядке байт.
+struct FrameHeader {
+    uint64_t seq;
+    uint32_t length;
+    uint32_t sourceLength;
+};
+
+const size_t FRAME_HEADER_SIZE = sizeof(FrameHeader);
+
+// Если в buffer лежит кадр целиком, заполняет header и возвращает true
+inline bool peekFrame(const char* buffer, size_t size, FrameHeader& header) {
+    if (size < FRAME_HEADER_SIZE) return false;
+    memcpy(&header, buffer, FRAME_HEADER_SIZE);
+    return size - FRAME_HEADER_SIZE >= header.length;
+}
+
+// Длина очередного кадра из available байт с начала base: до последнего перевода строки
+// в пределах limit; строка длиннее limit режется по размеру, но не посреди последовательности
+// UTF-8. 0 означает, что неполную строку нужно дочитать (если вход ещё не кончился).
+inline size_t frameCut(const char* base, size_t available, size_t limit, bool eof) {
+    size_t take = std::min(limit, available);
+    const char* newline = (const char*)memrchr(base, '\n', take);
+    if (newline != NULL) return newline + 1 - base;
+    if (available < limit && !eof) return 0;
+    if (take < available) {
+        size_t cut = take;
+        while (cut > take - 4 && ((unsigned char)base[cut] & 0xC0) == 0x80) --cut;
+        if (cut > take - 4) take = cut;
+    }
+    return take;
+}
+
+#endif // FRAME_PROTOCOL_H
@@ -0,0 +1,32 @@
+#include <unistd.h>
+#include <ctime>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#include "parent_common.h"
+
+void fail(const char* errorMsg) {
+    write(STDERR_FILENO, errorMsg, strlen(errorMsg));
+    exit(1);
+}
+
+// Дописывает весь буфер, обрабатывая частичную запись
+bool writeAll(int fd, const char* buffer, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, buffer, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buffer += n;
+        size -= n;
+    }
+    return true;
+}
+
+double nowSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
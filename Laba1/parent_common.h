@@ -0,0 +1,25 @@
+#ifndef PARENT_COMMON_H
+#define PARENT_COMMON_H
+
+#include <cstddef>
+
+// Быстрый детерминированный генератор (xorshift64) вместо rand() на каждую строку
+struct Random {
+    unsigned long long state;
+    unsigned long long next() {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+    size_t below(size_t bound) {
+        return next() % bound;
+    }
+};
+
+// Помощники из parent_common.cpp, общие для всех режимов родителя и замера конвейера
+void fail(const char* errorMsg);
+bool writeAll(int fd, const char* buffer, size_t size);
+double nowSeconds();
+
+#endif // PARENT_COMMON_H
@@ -1,34 +1,337 @@
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <climits>
+#include <cstdint>
 #include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+#include <cstdlib>
+#include <vector>
+#include <algorithm>
 
-bool isVowel(char c) {
-    char vowels[] = "AEIOUaeiou";
-    for (int i = 0; i < 10; ++i) {
-        if (c == vowels[i]) {
-            return true;
+#include "filter_library.h"
+#include "frame_protocol.h"
+#include "uring_stream.h"
+
+// Размер блока чтения: большой буфер, чтобы на мегабайт данных приходился один read и один write
+const size_t CHUNK_SIZE = 1 << 20;
+
+static char inBuffer[CHUNK_SIZE];
+static char outBuffer[CHUNK_SIZE];
+
+// read с повтором при прерывании сигналом
+ssize_t readSome(int fd, char* buffer, size_t size) {
+    ssize_t n;
+    do {
+        n = read(fd, buffer, size);
+    } while (n < 0 && errno == EINTR);
+    return n;
+}
+
+// Дописывает весь буфер, обрабатывая частичную запись
+bool writeAll(int fd, const char* buffer, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, buffer, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
         }
+        buffer += n;
+        size -= n;
     }
-    return false;
+    return true;
 }
 
-int main() {
-    char buffer[1024];
-    ssize_t bytesRead = read(STDIN_FILENO, buffer, sizeof(buffer) - 1);
+// Пишет целые строки порциями не больше limit, кроме строк длиннее limit. Запись в пайп не
+// длиннее PIPE_BUF атомарна, длинная может перемежаться с записями других детей.
+bool writeLines(int fd, const char* buffer, size_t size, size_t limit) {
+    while (size > 0) {
+        size_t piece = size;
+        if (size > limit) {
+            const char* last = (const char*)memrchr(buffer, '\n', limit);
+            if (last == NULL) last = (const char*)memchr(buffer + limit, '\n', size - limit);
+            piece = last ? last + 1 - buffer : size;
+        }
+        if (!writeAll(fd, buffer, piece)) return false;
+        buffer += piece;
+        size -= piece;
+    }
+    return true;
+}
+
+double nowSeconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void fail(const char* errorMsg) {
+    write(STDERR_FILENO, errorMsg, strlen(errorMsg));
+    _exit(1);
+}
+
+// Обычный режим: читаем до конца потока, каждый блок фильтруем и отдаём одним write.
+// Оборванная на границе блока последовательность UTF-8 переносится в начало следующего блока.
+// С lines (--lines) наружу уходят только целые строки: хвост результата после последнего '\n'
+// остаётся в начале буфера вывода до следующего чтения. Так выводы нескольких детей в общий
+// stdout перемежаются только по границам строк; в пайп строки пишутся порциями до PIPE_BUF,
+// потому что более длинная запись в пайп не атомарна. Обычный файл ядро пишет целиком.
+void filterStream(const Filter& filter, bool lines, unsigned long long& bytesIn, unsigned long long& bytesOut) {
+    std::vector<char> out(CHUNK_SIZE);
+    size_t carry = 0, tail = 0;
+    size_t limit = SIZE_MAX;
+    struct stat info;
+    if (lines && fstat(STDOUT_FILENO, &info) == 0 && (S_ISFIFO(info.st_mode) || S_ISSOCK(info.st_mode))) {
+        limit = PIPE_BUF;
+    }
+    while (true) {
+        ssize_t bytesRead = readSome(STDIN_FILENO, inBuffer + carry, CHUNK_SIZE - carry);
+        if (bytesRead < 0) {
+            fail("Read failed\n");
+        }
+        if (bytesRead == 0) break;
+
+        size_t available = carry + bytesRead, consumed;
+        if (out.size() < tail + CHUNK_SIZE) out.resize(tail + CHUNK_SIZE); // Строка длиннее блока
+        size_t kept = filter.apply(inBuffer, available, out.data() + tail, consumed);
+        size_t total = tail + kept, whole = total;
+        if (lines) {
+            const char* last = (const char*)memrchr(out.data(), '\n', total);
+            whole = last ? last + 1 - out.data() : 0;
+        }
+        if (!writeLines(STDOUT_FILENO, out.data(), whole, limit)) {
+            fail("Write failed\n");
+        }
+        tail = total - whole;
+        memmove(out.data(), out.data() + whole, tail);
+        carry = available - consumed;
+        memmove(inBuffer, inBuffer + consumed, carry);
 
-    if (bytesRead < 0) {
-        const char* errorMsg = "Read failed\n";
-        write(STDERR_FILENO, errorMsg, strlen(errorMsg));
-        _exit(1);
+        bytesIn += bytesRead;
+        bytesOut += kept;
+    }
+    // Последняя строка без перевода строки
+    if (!writeAll(STDOUT_FILENO, out.data(), tail)) {
+        fail("Write failed\n");
     }
+    // Вход кончился посреди последовательности: её байты выводятся как есть
+    if (carry > 0) {
+        if (!writeAll(STDOUT_FILENO, inBuffer, carry)) {
+            fail("Write failed\n");
+        }
+        bytesOut += carry;
+    }
+}
 
-    buffer[bytesRead] = '\0';
+// Режим кадров (--framed): каждый входной кадр фильтруется отдельно и возвращается с тем же seq.
+// Все кадры, целиком пришедшие за одно чтение, отправляются обратно одним write.
+void filterFrames(const Filter& filter, unsigned long long& bytesIn, unsigned long long& bytesOut) {
+    std::vector<char> in(CHUNK_SIZE);
+    std::vector<char> out(CHUNK_SIZE);
+    size_t have = 0;
+    while (true) {
+        ssize_t bytesRead = readSome(STDIN_FILENO, in.data() + have, in.size() - have);
+        if (bytesRead < 0) {
+            fail("Read failed\n");
+        }
+        if (bytesRead == 0) break;
+        have += bytesRead;
 
-    // Проходим по каждому символу и выводим только согласные
-    for (int i = 0; i < bytesRead; ++i) {
-        if (!isVowel(buffer[i])) {
-            write(STDOUT_FILENO, &buffer[i], 1);
+        size_t pos = 0, outLen = 0;
+        FrameHeader header;
+        while (peekFrame(in.data() + pos, have - pos, header)) {
+            size_t need = outLen + FRAME_HEADER_SIZE + header.length;
+            if (need > out.size()) out.resize(need * 2);
+            size_t kept = filterBlock(filter, in.data() + pos + FRAME_HEADER_SIZE, header.length,
+                                      out.data() + outLen + FRAME_HEADER_SIZE);
+            bytesIn += header.length;
+            bytesOut += kept;
+            pos += FRAME_HEADER_SIZE + header.length;
+            header.sourceLength = header.length;
+            header.length = (uint32_t)kept;
+            memcpy(out.data() + outLen, &header, FRAME_HEADER_SIZE);
+            outLen += FRAME_HEADER_SIZE + kept;
         }
+        if (!writeAll(STDOUT_FILENO, out.data(), outLen)) {
+            fail("Write failed\n");
+        }
+
+        // Недочитанный кадр переносим в начало; если он не помещается, буфер растёт
+        memmove(in.data(), in.data() + pos, have - pos);
+        have -= pos;
+        if (have >= FRAME_HEADER_SIZE) {
+            memcpy(&header, in.data(), FRAME_HEADER_SIZE);
+            if (FRAME_HEADER_SIZE + header.length > in.size()) in.resize(FRAME_HEADER_SIZE + header.length);
+        }
+    }
+    if (have != 0) {
+        fail("Truncated frame at end of input\n");
+    }
+}
+
+// Режим файла (--file): вход отображается в память и фильтруется прямо из отображения, без read.
+// Результат пишется в stdout блоками по CHUNK_SIZE или, с --output, в отображённый выходной файл,
+// заранее растянутый ftruncate до размера входа и обрезанный до итоговой длины в конце.
+void filterMapped(const Filter& filter, const char* inputPath, const char* outputPath,
+                  unsigned long long& bytesIn, unsigned long long& bytesOut) {
+    int fd = open(inputPath, O_RDONLY);
+    if (fd == -1) {
+        fail("Failed to open input file\n");
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1) {
+        fail("fstat failed\n");
+    }
+    size_t size = info.st_size;
+    const char* input = NULL;
+    if (size > 0) {
+        void* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            fail("Failed to mmap input file\n");
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL); // Ядро читает вперёд крупнее и раньше освобождает пройденное
+        input = (const char*)mapped;
+    }
+    close(fd);
+
+    int outFd = -1;
+    char* output = outBuffer;
+    if (outputPath != NULL) {
+        outFd = open(outputPath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (outFd == -1) {
+            fail("Failed to open output file\n");
+        }
+        // Результат не длиннее входа: файл растягивается до размера входа и отображается целиком
+        if (size > 0) {
+            if (ftruncate(outFd, size) == -1) {
+                fail("ftruncate failed\n");
+            }
+            void* mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, outFd, 0);
+            if (mapped == MAP_FAILED) {
+                fail("Failed to mmap output file\n");
+            }
+            output = (char*)mapped;
+        }
+    }
+
+    size_t pos = 0, outLen = 0;
+    while (pos < size) {
+        size_t length = std::min(CHUNK_SIZE, size - pos);
+        char* target = outFd != -1 ? output + outLen : outBuffer;
+        size_t consumed, kept;
+        if (pos + length == size) {
+            // Последний блок: оборванная концом файла последовательность переносится как есть
+            kept = filterBlock(filter, input + pos, length, target);
+            consumed = length;
+        } else {
+            kept = filter.apply(input + pos, length, target, consumed);
+        }
+        if (outFd == -1 && !writeAll(STDOUT_FILENO, outBuffer, kept)) {
+            fail("Write failed\n");
+        }
+        pos += consumed;
+        outLen += kept;
+    }
+    bytesIn += size;
+    bytesOut += outLen;
+
+    if (size > 0) {
+        munmap((void*)input, size);
+    }
+    if (outFd != -1) {
+        if (size > 0) {
+            munmap(output, size);
+        }
+        if (ftruncate(outFd, outLen) == -1) {
+            fail("ftruncate failed\n");
+        }
+        close(outFd);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    bool printStats = false;
+    bool framed = false;
+    bool utf8 = false;
+    const char* dropSpec = NULL;
+    const char* keepSpec = NULL;
+    const char* inputPath = NULL;
+    const char* outputPath = NULL;
+    bool uring = false;
+    bool lines = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--stats") == 0) {
+            printStats = true;
+        } else if (strcmp(argv[i], "--framed") == 0) {
+            framed = true;
+        } else if (strcmp(argv[i], "--utf8") == 0) {
+            utf8 = true;
+        } else if (strcmp(argv[i], "--lines") == 0) {
+            lines = true;
+        } else if (strcmp(argv[i], "--drop") == 0 && i + 1 < argc) {
+            dropSpec = argv[++i];
+        } else if (strcmp(argv[i], "--keep") == 0 && i + 1 < argc) {
+            keepSpec = argv[++i];
+        } else if (strcmp(argv[i], "--file") == 0 && i + 1 < argc) {
+            inputPath = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (strcmp(argv[i], "--io") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "uring") == 0) {
+                uring = true;
+            } else if (strcmp(argv[i], "sync") == 0) {
+                uring = false;
+            } else {
+                fail("Invalid --io, expected uring or sync\n");
+            }
+        } else if (strcmp(argv[i], "--self-check") == 0) {
+            return selfCheckKernels() ? 0 : 1;
+        } else {
+            fail("Usage: remove_vowels [--drop SET] [--keep SET] [--utf8] [--stats] [--framed] [--lines]\n"
+                 "                     [--file PATH [--output PATH]] [--io uring|sync] [--self-check]\n"
+                 "  SET: characters and ranges, e.g. 'aeiou' or 'a-zA-Z0-9\\n', escapes \\n \\t \\r \\\\ \\- \\xHH\n"
+                 "  --utf8: input is UTF-8, Cyrillic vowels are removed as well\n"
+                 "  --lines: every write to stdout ends on a line boundary (stdout shared with other workers)\n"
+                 "  --file: read PATH through mmap instead of stdin; --output: write to a mapped file\n"
+                 "  --io uring: overlap stdin/stdout I/O with filtering, falls back to sync if unavailable\n");
+        }
+    }
+
+    Filter filter;
+    if (!buildFilter(filter, dropSpec, keepSpec, utf8)) {
+        fail("Invalid character set\n");
+    }
+    if (outputPath != NULL && inputPath == NULL) {
+        fail("--output requires --file\n");
+    }
+    if (framed && inputPath != NULL) {
+        fail("--framed cannot be combined with --file\n");
+    }
+    if (lines && (framed || inputPath != NULL || uring)) {
+        fail("--lines applies only to the synchronous stream mode\n");
+    }
+    unsigned long long bytesIn = 0, bytesOut = 0;
+    double start = nowSeconds();
+
+    if (inputPath != NULL) {
+        filterMapped(filter, inputPath, outputPath, bytesIn, bytesOut);
+    } else if (framed) {
+        filterFrames(filter, bytesIn, bytesOut);
+    } else if (!uring || !filterStreamUring(filter, bytesIn, bytesOut)) {
+        filterStream(filter, lines, bytesIn, bytesOut);
+    }
+
+    if (printStats) {
+        double elapsed = nowSeconds() - start;
+        double mbPerSec = elapsed > 0 ? bytesIn / elapsed / 1e6 : 0.0;
+        char msg[256];
+        int len = snprintf(msg, sizeof(msg), "remove_vowels [%s]: in=%llu B, out=%llu B, time=%.3f s, %.1f MB/s\n",
+                           filter.kernel.name, bytesIn, bytesOut, elapsed, mbPerSec);
+        write(STDERR_FILENO, msg, len);
     }
 
     return 0;
@@ -0,0 +1,81 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include <ctime>
+#include <sched.h>
+
+// Кольцевая очередь без блокировок для одного писателя и одного читателя.
+// Индексы лежат в разных кэш-линиях, и каждая сторона держит копию чужого индекса,
+// так что в обычном случае push и pop не трогают линию другой стороны.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : slots(roundUp(capacity)), mask(slots.size() - 1) {}
+
+    // false, если очередь полна
+    bool push(const T& value) {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail - cachedHead == slots.size()) {
+            cachedHead = headIndex.load(std::memory_order_acquire);
+            if (tail - cachedHead == slots.size()) return false;
+        }
+        slots[tail & mask] = value;
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // false, если очередь пуста
+    bool pop(T& value) {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        if (head == cachedTail) {
+            cachedTail = tailIndex.load(std::memory_order_acquire);
+            if (head == cachedTail) return false;
+        }
+        value = slots[head & mask];
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static size_t roundUp(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        return size;
+    }
+
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> headIndex{0}; // Сторона читателя
+    size_t cachedTail = 0;
+    alignas(64) std::atomic<size_t> tailIndex{0}; // Сторона писателя
+    size_t cachedHead = 0;
+};
+
+// Ожидание соседа по очереди: сначала короткое вращение, затем уступаем процессор,
+// а при долгом простое засыпаем, чтобы ждущий поток не занимал ядро целиком
+struct Backoff {
+    unsigned spins = 0;
+
+    void pause() {
+        if (spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else if (spins < 1024) {
+            sched_yield();
+        } else {
+            timespec delay = {0, 50 * 1000};
+            nanosleep(&delay, NULL);
+        }
+        ++spins;
+    }
+
+    void reset() {
+        spins = 0;
+    }
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,194 @@
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "stage_pipeline.h"
+
+extern char** environ;
+
+// Запущенная стадия и то, что о ней известно после завершения
+struct Stage {
+    std::string name;
+    pid_t pid;
+    unsigned long long bytesRead;
+    unsigned long long bytesWritten;
+    double cpuSeconds;
+    int status;
+};
+
+std::vector<std::string> splitStageCommand(const std::string& spec) {
+    std::vector<std::string> words;
+    size_t pos = 0;
+    while (pos < spec.size()) {
+        size_t end = spec.find(' ', pos);
+        if (end == std::string::npos) end = spec.size();
+        if (end > pos) words.push_back(spec.substr(pos, end - pos));
+        pos = end + 1;
+    }
+    return words;
+}
+
+bool isWorkerStage(const std::string& spec) {
+    std::vector<std::string> words = splitStageCommand(spec);
+    return !words.empty() && words[0] == "remove_vowels";
+}
+
+// Аргументы стадии. remove_vowels запускается из того же места, что и обычные дети,
+// lowercase и dedupe раскрываются в стандартные tr и uniq, остальное ищется в PATH.
+std::vector<std::string> stageArgs(const std::string& spec, const StageConfig& config) {
+    std::vector<std::string> words = splitStageCommand(spec);
+    if (words.empty()) fail("Empty --stage command\n");
+    if (isWorkerStage(spec)) {
+        words[0] = config.workerPath;
+        if (config.utf8) words.push_back("--utf8");
+    } else if (words[0] == "lowercase" && words.size() == 1) {
+        words = {"tr", "[:upper:]", "[:lower:]"};
+    } else if (words[0] == "dedupe" && words.size() == 1) {
+        words = {"uniq"};
+    }
+    return words;
+}
+
+pid_t spawnStage(const std::vector<std::string>& words, int readFd, int writeFd) {
+    std::vector<char*> argv;
+    for (const std::string& word : words) argv.push_back((char*)word.c_str());
+    argv.push_back(NULL);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (readFd != STDIN_FILENO) posix_spawn_file_actions_adddup2(&actions, readFd, STDIN_FILENO);
+    if (writeFd != STDOUT_FILENO) posix_spawn_file_actions_adddup2(&actions, writeFd, STDOUT_FILENO);
+    // Родитель игнорирует SIGPIPE, а стадии должны завершаться по нему, как в обычном конвейере
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t defaults;
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &defaults);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+    int rc = posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    if (rc != 0) {
+        fail("Failed to start a stage\n");
+    }
+    return pid;
+}
+
+// rchar и wchar из /proc/PID/io: сколько байт процесс прочитал и записал системными вызовами,
+// включая файлы, которые он открывает сам. Читается, пока завершившаяся стадия ещё не убрана waitpid.
+void readProcessIo(pid_t pid, unsigned long long& bytesRead, unsigned long long& bytesWritten) {
+    bytesRead = bytesWritten = 0;
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/io", (int)pid);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+    char text[512];
+    ssize_t len = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    if (len <= 0) return;
+    text[len] = '\0';
+    const char* field = strstr(text, "rchar:");
+    if (field != NULL) bytesRead = strtoull(field + 6, NULL, 10);
+    field = strstr(text, "wchar:");
+    if (field != NULL) bytesWritten = strtoull(field + 6, NULL, 10);
+}
+
+// Ввод-вывод команды на пустом вводе с выводом в /dev/null: её собственные расходы на запуск
+void readStartupIo(const std::vector<std::string>& words, unsigned long long& bytesRead,
+                   unsigned long long& bytesWritten) {
+    int input = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    int output = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (input == -1 || output == -1) fail("Failed to open /dev/null\n");
+    pid_t pid = spawnStage(words, input, output);
+    close(input);
+    close(output);
+    siginfo_t info;
+    waitid(P_PID, pid, &info, WEXITED | WNOWAIT);
+    readProcessIo(pid, bytesRead, bytesWritten);
+    waitpid(pid, NULL, 0);
+}
+
+int runStagePipeline(const StageConfig& config) {
+    // Замер запуска идёт до конвейера, чтобы не попасть во время и не делить с ним процессор
+    std::vector<unsigned long long> startupRead(config.stages.size()), startupWritten(config.stages.size());
+    if (config.printStats) {
+        for (size_t i = 0; i < config.stages.size(); ++i) {
+            readStartupIo(stageArgs(config.stages[i], config), startupRead[i], startupWritten[i]);
+        }
+    }
+
+    double start = nowSeconds();
+    std::vector<Stage> stages;
+    int pipeBytes = 0;
+    int readFd = STDIN_FILENO;
+    for (size_t i = 0; i < config.stages.size(); ++i) {
+        std::vector<std::string> words = stageArgs(config.stages[i], config);
+        int fds[2] = {-1, STDOUT_FILENO};
+        if (i + 1 < config.stages.size()) {
+            if (pipe2(fds, O_CLOEXEC) == -1) {
+                fail("Pipe creation failed\n");
+            }
+            // Больший буфер сглаживает неравномерность стадий; при отказе остаётся буфер по умолчанию
+            fcntl(fds[1], F_SETPIPE_SZ, (int)config.pipeSize);
+            pipeBytes = fcntl(fds[1], F_GETPIPE_SZ);
+        }
+        Stage stage = {config.stages[i], spawnStage(words, readFd, fds[1]), 0, 0, 0.0, 0};
+        stages.push_back(stage);
+        if (readFd != STDIN_FILENO) close(readFd);
+        if (fds[1] != STDOUT_FILENO) close(fds[1]);
+        readFd = fds[0];
+    }
+
+    int exitCode = 0;
+    for (size_t i = 0; i < stages.size(); ++i) {
+        Stage& stage = stages[i];
+        siginfo_t info;
+        waitid(P_PID, stage.pid, &info, WEXITED | WNOWAIT); // Завершилась, но ещё не убрана
+        readProcessIo(stage.pid, stage.bytesRead, stage.bytesWritten);
+        stage.bytesRead -= std::min(stage.bytesRead, startupRead[i]);
+        stage.bytesWritten -= std::min(stage.bytesWritten, startupWritten[i]);
+        rusage usage;
+        wait4(stage.pid, &stage.status, 0, &usage);
+        stage.cpuSeconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    }
+    // Как у оболочки: код конвейера - код последней стадии, ранние стадии могут законно
+    // завершиться по SIGPIPE, если последняя прочитала всё, что ей нужно
+    const Stage& last = stages.back();
+    if (!WIFEXITED(last.status) || WEXITSTATUS(last.status) != 0) exitCode = 1;
+    double wall = nowSeconds() - start;
+
+    if (config.printStats) {
+        size_t bottleneck = 0;
+        for (size_t i = 0; i < stages.size(); ++i) {
+            const Stage& stage = stages[i];
+            if (stage.cpuSeconds > stages[bottleneck].cpuSeconds) bottleneck = i;
+            char msg[256];
+            int msgLen = snprintf(msg, sizeof(msg),
+                                  "stage %zu (%s): syscall in %llu B, out %llu B, cpu %.3f s, busy %.0f%%, %.1f MB/s per cpu-second%s\n",
+                                  i + 1, stage.name.c_str(), stage.bytesRead, stage.bytesWritten, stage.cpuSeconds,
+                                  wall > 0 ? stage.cpuSeconds / wall * 100 : 0.0,
+                                  stage.cpuSeconds > 0 ? stage.bytesRead / stage.cpuSeconds / 1e6 : 0.0,
+                                  WIFEXITED(stage.status) && WEXITSTATUS(stage.status) == 0 ? ""
+                                  : WIFSIGNALED(stage.status) && WTERMSIG(stage.status) == SIGPIPE ? ", stopped by SIGPIPE"
+                                  : ", FAILED");
+            write(STDERR_FILENO, msg, msgLen);
+        }
+        char msg[256];
+        int msgLen = snprintf(msg, sizeof(msg), "pipeline: %zu stages, pipe buffer %d B, wall %.3f s, bottleneck stage %zu (%s)\n",
+                              stages.size(), pipeBytes, wall, bottleneck + 1, stages[bottleneck].name.c_str());
+        write(STDERR_FILENO, msg, msgLen);
+    }
+    return exitCode;
+}
@@ -0,0 +1,31 @@
+#ifndef STAGE_PIPELINE_H
+#define STAGE_PIPELINE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "parent_common.h"
+
+// Режим 1laba --stage CMD [--stage CMD ...]: цепочка преобразований, по процессу на стадию,
+// соединённых пайпами с увеличенным буфером. Родитель только запускает стадии и собирает
+// по каждой объём ввода-вывода и время процессора, чтобы было видно самую медленную.
+// С --stats каждая стадия сначала запускается на пустом вводе: байты, которые она читает
+// и пишет при запуске (загрузчик, локаль), вычитаются из её счётчиков.
+struct StageConfig {
+    std::vector<std::string> stages; // Команды стадий, слова через пробел
+    std::string workerPath;          // Исполняемый файл для стадии remove_vowels
+    size_t pipeSize;                 // Желаемый буфер пайпов между стадиями (F_SETPIPE_SZ)
+    bool utf8;                       // Передать --utf8 стадиям remove_vowels
+    bool printStats;
+};
+
+// Слова команды стадии, разделённые пробелами
+std::vector<std::string> splitStageCommand(const std::string& spec);
+// Стадия запускает remove_vowels: первое слово команды совпадает с ним целиком
+bool isWorkerStage(const std::string& spec);
+
+// Возвращает код выхода последней стадии: 0 или 1
+int runStagePipeline(const StageConfig& config);
+
+#endif // STAGE_PIPELINE_H
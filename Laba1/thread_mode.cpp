@@ -0,0 +1,241 @@
+#include <unistd.h>
+#include <sys/resource.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "thread_mode.h"
+#include "filter_library.h"
+#include "frame_protocol.h"
+#include "spsc_queue.h"
+
+// Размер блока входа и сколько блоков поток забирает одним пакетным вызовом фильтра
+const size_t BLOCK_PAYLOAD = 64 * 1024;
+const size_t BATCH_LIMIT = 16;
+// Ёмкость очередей каждого потока в блоках
+const size_t THREAD_QUEUE_BLOCKS = 64;
+// Упорядоченный вывод: сколько блоков может быть в работе сверх ещё не выведенного
+const size_t THREAD_REORDER_WINDOW = 256;
+const size_t THREAD_READ_CHUNK = 1 << 20;
+// Вывод копится и пишется в stdout такими порциями или когда готовых блоков больше нет
+const size_t OUTPUT_FLUSH = 1 << 20;
+
+// Блок входа вместе с местом под результат; владелец переходит от читателя к потоку и к выводу
+struct Block {
+    unsigned long long seq;
+    std::vector<char> input;
+    std::vector<char> output;
+    size_t outputLength;
+};
+
+struct ThreadWorker {
+    SpscQueue<Block*> jobs{THREAD_QUEUE_BLOCKS};    // Читатель -> поток; NULL означает конец входа
+    SpscQueue<Block*> results{THREAD_QUEUE_BLOCKS}; // Поток -> вывод; NULL после последнего блока
+    std::atomic<size_t> queued{0};                  // Байт отдано потоку и ещё не отфильтровано
+    int weight = 1;
+    unsigned long long blocks = 0;  // Статистика пишется только самим потоком и читается после join
+    unsigned long long bytes = 0;
+    unsigned long long batches = 0;
+    std::thread thread;
+};
+
+template <typename T>
+void pushWaiting(SpscQueue<T>& queue, const T& value) {
+    Backoff backoff;
+    while (!queue.push(value)) backoff.pause();
+}
+
+// Поток-фильтр: забирает все готовые блоки (не больше BATCH_LIMIT) и фильтрует их одним вызовом
+void filterThread(ThreadWorker& worker, const Filter& filter) {
+    Block* batch[BATCH_LIMIT];
+    FilterBuffer buffers[BATCH_LIMIT];
+    bool stop = false;
+    Backoff backoff;
+    while (!stop) {
+        size_t count = 0;
+        Block* block;
+        while (count < BATCH_LIMIT && worker.jobs.pop(block)) {
+            if (block == NULL) {
+                stop = true;
+                break;
+            }
+            batch[count++] = block;
+        }
+        if (count == 0) {
+            if (!stop) backoff.pause();
+            continue;
+        }
+        backoff.reset();
+
+        size_t bytes = 0;
+        for (size_t i = 0; i < count; ++i) {
+            buffers[i] = {batch[i]->input.data(), batch[i]->input.size(), batch[i]->output.data(), 0};
+            bytes += batch[i]->input.size();
+        }
+        filterBatch(filter, buffers, count);
+        for (size_t i = 0; i < count; ++i) {
+            batch[i]->outputLength = buffers[i].outputLength;
+            pushWaiting(worker.results, batch[i]);
+        }
+        worker.queued.fetch_sub(bytes, std::memory_order_relaxed);
+        worker.blocks += count;
+        worker.bytes += bytes;
+        worker.batches++;
+    }
+    pushWaiting(worker.results, (Block*)NULL);
+}
+
+// Поток вывода: собирает результаты всех фильтров и пишет их в stdout, в упорядоченном
+// режиме по номерам блоков. emitted сообщает читателю, сколько блоков уже выведено.
+void outputThread(std::vector<std::unique_ptr<ThreadWorker>>& workers, bool ordered,
+                  std::atomic<unsigned long long>& emitted) {
+    std::vector<char> output;
+    output.reserve(OUTPUT_FLUSH + BLOCK_PAYLOAD);
+    std::vector<Block*> waiting(THREAD_REORDER_WINDOW, NULL);
+    unsigned long long nextToEmit = 0;
+    size_t finished = 0;
+    Backoff backoff;
+    while (finished < workers.size()) {
+        bool progress = false;
+        for (std::unique_ptr<ThreadWorker>& worker : workers) {
+            Block* block;
+            while (worker->results.pop(block)) {
+                progress = true;
+                if (block == NULL) {
+                    finished++;
+                } else if (ordered) {
+                    waiting[block->seq % THREAD_REORDER_WINDOW] = block;
+                } else {
+                    output.insert(output.end(), block->output.data(), block->output.data() + block->outputLength);
+                    delete block;
+                }
+            }
+        }
+        if (ordered) {
+            Block* block;
+            while ((block = waiting[nextToEmit % THREAD_REORDER_WINDOW]) != NULL) {
+                output.insert(output.end(), block->output.data(), block->output.data() + block->outputLength);
+                waiting[nextToEmit % THREAD_REORDER_WINDOW] = NULL;
+                delete block;
+                nextToEmit++;
+            }
+            emitted.store(nextToEmit, std::memory_order_release);
+        }
+        if (output.size() >= OUTPUT_FLUSH || (!progress && !output.empty())) {
+            if (!writeAll(STDOUT_FILENO, output.data(), output.size())) fail("Write to stdout failed\n");
+            output.clear();
+        }
+        if (progress) {
+            backoff.reset();
+        } else {
+            backoff.pause();
+        }
+    }
+    if (!writeAll(STDOUT_FILENO, output.data(), output.size())) fail("Write to stdout failed\n");
+}
+
+// Выбор потока для блока: случайно по весам или с наименьшим объёмом неотфильтрованных байт
+ThreadWorker& pickThread(std::vector<std::unique_ptr<ThreadWorker>>& workers, unsigned long long totalWeight,
+                         ThreadModeConfig& config) {
+    if (!config.weights.empty()) {
+        unsigned long long r = config.random.next() % totalWeight;
+        for (std::unique_ptr<ThreadWorker>& worker : workers) {
+            if (r < (unsigned long long)worker->weight) return *worker;
+            r -= worker->weight;
+        }
+    }
+    ThreadWorker* best = workers[0].get();
+    for (std::unique_ptr<ThreadWorker>& worker : workers) {
+        if (worker->queued.load(std::memory_order_relaxed) < best->queued.load(std::memory_order_relaxed)) {
+            best = worker.get();
+        }
+    }
+    return *best;
+}
+
+void runThreadMode(ThreadModeConfig& config) {
+    double start = nowSeconds();
+    Filter filter;
+    buildFilter(filter, NULL, NULL, config.utf8);
+
+    std::vector<std::unique_ptr<ThreadWorker>> workers;
+    unsigned long long totalWeight = 0;
+    for (size_t i = 0; i < config.threads; ++i) {
+        workers.emplace_back(new ThreadWorker());
+        workers[i]->weight = config.weights.empty() ? 1 : config.weights[i];
+        totalWeight += workers[i]->weight;
+    }
+    for (std::unique_ptr<ThreadWorker>& worker : workers) {
+        worker->thread = std::thread(filterThread, std::ref(*worker), std::cref(filter));
+    }
+    std::atomic<unsigned long long> emitted{0};
+    std::thread writer(outputThread, std::ref(workers), config.ordered, std::ref(emitted));
+
+    // Читатель режет вход на блоки по frameCut и раздаёт их потокам
+    std::vector<char> input(THREAD_READ_CHUNK);
+    size_t have = 0;
+    bool eof = false;
+    unsigned long long nextSeq = 0, bytesIn = 0;
+    while (!eof || have > 0) {
+        if (!eof) {
+            ssize_t n = read(STDIN_FILENO, input.data() + have, input.size() - have);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fail("Read failed\n");
+            }
+            if (n == 0) eof = true;
+            have += n > 0 ? n : 0;
+            bytesIn += n > 0 ? n : 0;
+        }
+        size_t pos = 0;
+        while (pos < have) {
+            size_t take = frameCut(input.data() + pos, have - pos, BLOCK_PAYLOAD, eof);
+            if (take == 0) break;
+            if (config.ordered) {
+                Backoff backoff;
+                while (nextSeq - emitted.load(std::memory_order_acquire) >= THREAD_REORDER_WINDOW) backoff.pause();
+            }
+            const char* base = input.data() + pos;
+            Block* block = new Block{nextSeq++, std::vector<char>(base, base + take), std::vector<char>(take), 0};
+            ThreadWorker& worker = pickThread(workers, totalWeight, config);
+            worker.queued.fetch_add(take, std::memory_order_relaxed);
+            pushWaiting(worker.jobs, block);
+            pos += take;
+        }
+        memmove(input.data(), input.data() + pos, have - pos);
+        have -= pos;
+    }
+
+    for (std::unique_ptr<ThreadWorker>& worker : workers) {
+        pushWaiting(worker->jobs, (Block*)NULL);
+    }
+    for (std::unique_ptr<ThreadWorker>& worker : workers) {
+        worker->thread.join();
+    }
+    writer.join();
+
+    if (config.printStats) {
+        for (size_t i = 0; i < workers.size(); ++i) {
+            char msg[160];
+            const ThreadWorker& worker = *workers[i];
+            int msgLen = snprintf(msg, sizeof(msg), "thread %zu: %llu blocks, %llu bytes, %llu batches, avg %.1f blocks/batch\n",
+                                  i + 1, worker.blocks, worker.bytes, worker.batches,
+                                  worker.batches ? (double)worker.blocks / worker.batches : 0.0);
+            write(STDERR_FILENO, msg, msgLen);
+        }
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        char msg[160];
+        double elapsed = nowSeconds() - start;
+        int msgLen = snprintf(msg, sizeof(msg), "parent: threads%s [%s], wall %.3f s, user %.3f s, sys %.3f s, %.1f MB/s\n",
+                              config.ordered ? " ordered" : "", filter.kernel.name, elapsed,
+                              usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6,
+                              usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6,
+                              elapsed > 0 ? bytesIn / elapsed / 1e6 : 0.0);
+        write(STDERR_FILENO, msg, msgLen);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef THREAD_MODE_H
+#define THREAD_MODE_H
+
+#include <cstddef>
+#include <vector>
+
+#include "parent_common.h"
+
+// Режим 1laba --threads: фильтры работают пулом потоков внутри родителя, блоки входа
+// передаются им и обратно через очереди без блокировок, без запуска процессов и пайпов
+struct ThreadModeConfig {
+    size_t threads;
+    std::vector<int> weights; // Пусто - маршрутизация по наименьшей очереди
+    Random random;
+    bool ordered;             // Вывод в порядке входа; иначе в порядке готовности блоков
+    bool utf8;
+    bool printStats;
+};
+
+void runThreadMode(ThreadModeConfig& config);
+
+#endif // THREAD_MODE_H
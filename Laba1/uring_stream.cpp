@@ -0,0 +1,335 @@
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include "uring_stream.h"
+
+// liburing не требуется: кольца настраиваются напрямую системными вызовами io_uring_*
+
+// Блоки в полёте и размер каждого. Все буферы регистрируются в ядре (IORING_REGISTER_BUFFERS),
+// поэтому их суммарный объём держится в пределах обычного RLIMIT_MEMLOCK в 8 МиБ.
+const size_t URING_SLOTS = 4;
+const size_t URING_CHUNK = 512 * 1024;
+// Место перед данными блока под хвост последовательности UTF-8 из предыдущего блока
+const size_t URING_HEADROOM = 4;
+
+struct Ring {
+    int fd;
+    unsigned* sqHead;
+    unsigned* sqTail;
+    unsigned sqMask;
+    unsigned sqEntries;
+    unsigned* sqArray;
+    io_uring_sqe* sqes;
+    unsigned* cqHead;
+    unsigned* cqTail;
+    unsigned cqMask;
+    io_uring_cqe* cqes;
+    unsigned queued;   // Заполнено SQE, ещё не переданных ядру
+    void* sqRing;
+    void* cqRing;
+    size_t sqRingSize;
+    size_t cqRingSize;
+    size_t sqesSize;
+};
+
+bool ringInit(Ring& ring, unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring.fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring.fd < 0) return false;
+
+    ring.sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring.cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) ring.sqRingSize = ring.cqRingSize = std::max(ring.sqRingSize, ring.cqRingSize);
+    ring.sqRing = mmap(NULL, ring.sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd,
+                       IORING_OFF_SQ_RING);
+    ring.cqRing = single ? ring.sqRing
+                         : mmap(NULL, ring.cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring.fd,
+                                IORING_OFF_CQ_RING);
+    ring.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    ring.sqes = (io_uring_sqe*)mmap(NULL, ring.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                    ring.fd, IORING_OFF_SQES);
+    if (ring.sqRing == MAP_FAILED || ring.cqRing == MAP_FAILED || ring.sqes == MAP_FAILED) {
+        close(ring.fd);
+        return false;
+    }
+
+    char* sq = (char*)ring.sqRing;
+    ring.sqHead = (unsigned*)(sq + params.sq_off.head);
+    ring.sqTail = (unsigned*)(sq + params.sq_off.tail);
+    ring.sqMask = *(unsigned*)(sq + params.sq_off.ring_mask);
+    ring.sqEntries = *(unsigned*)(sq + params.sq_off.ring_entries);
+    ring.sqArray = (unsigned*)(sq + params.sq_off.array);
+    char* cq = (char*)ring.cqRing;
+    ring.cqHead = (unsigned*)(cq + params.cq_off.head);
+    ring.cqTail = (unsigned*)(cq + params.cq_off.tail);
+    ring.cqMask = *(unsigned*)(cq + params.cq_off.ring_mask);
+    ring.cqes = (io_uring_cqe*)(cq + params.cq_off.cqes);
+    ring.queued = 0;
+    return true;
+}
+
+void ringDestroy(Ring& ring) {
+    munmap(ring.sqes, ring.sqesSize);
+    if (ring.cqRing != ring.sqRing) munmap(ring.cqRing, ring.cqRingSize);
+    munmap(ring.sqRing, ring.sqRingSize);
+    close(ring.fd);
+}
+
+// Умеет ли ядро нужные чтение и запись. IORING_REGISTER_PROBE появился в 5.6 вместе
+// с IORING_OP_READ и IORING_OP_WRITE; на более старом ядре с io_uring есть только
+// READ_FIXED и WRITE_FIXED (с 5.1), так что без пробы годятся лишь зарегистрированные буферы.
+bool ringSupports(Ring& ring, bool fixed) {
+    const unsigned opCount = 256;
+    io_uring_probe* probe = (io_uring_probe*)calloc(1, sizeof(io_uring_probe) + opCount * sizeof(io_uring_probe_op));
+    if (probe == NULL) fail("Out of memory\n");
+    bool supported = fixed;
+    if (syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_PROBE, probe, opCount) == 0) {
+        auto has = [&](unsigned op) {
+            return op <= probe->last_op && op < probe->ops_len && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+        };
+        supported = fixed ? has(IORING_OP_READ_FIXED) && has(IORING_OP_WRITE_FIXED)
+                          : has(IORING_OP_READ) && has(IORING_OP_WRITE);
+    }
+    free(probe);
+    return supported;
+}
+
+// Свободная SQE в хвосте очереди отправки; колец хватает на все операции в полёте
+io_uring_sqe* ringSqe(Ring& ring) {
+    unsigned tail = *ring.sqTail + ring.queued;
+    if (tail - __atomic_load_n(ring.sqHead, __ATOMIC_ACQUIRE) >= ring.sqEntries) fail("io_uring queue overflow\n");
+    unsigned index = tail & ring.sqMask;
+    ring.sqArray[index] = index;
+    ring.queued++;
+    io_uring_sqe* sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// Передаёт ядру заполненные SQE и, если wait, ждёт хотя бы одного завершения
+void ringSubmit(Ring& ring, bool wait) {
+    unsigned toSubmit = ring.queued;
+    __atomic_store_n(ring.sqTail, *ring.sqTail + ring.queued, __ATOMIC_RELEASE);
+    ring.queued = 0;
+    if (toSubmit == 0 && !wait) return;
+    while (syscall(__NR_io_uring_enter, ring.fd, toSubmit, wait ? 1 : 0, wait ? IORING_ENTER_GETEVENTS : 0,
+                   NULL, 0) < 0) {
+        if (errno != EINTR) fail("io_uring_enter failed\n");
+        toSubmit = 0;
+    }
+}
+
+enum SlotState {
+    SLOT_FREE,
+    SLOT_READING,
+    SLOT_READY,    // Прочитан, ждёт фильтра
+    SLOT_FILTERED, // Отфильтрован, ждёт очереди на запись
+    SLOT_WRITING
+};
+
+// Блок конвейера: входной и выходной буферы и их зарегистрированные номера 2*i и 2*i+1
+struct Slot {
+    SlotState state;
+    unsigned long long seq;
+    char* in;        // Данные читаются в in + URING_HEADROOM
+    char* out;
+    size_t filled;
+    size_t outLen;
+    size_t written;
+    off_t outOffset; // Смещение в выходном файле; -1 для пайпа
+};
+
+// Метка операции в user_data: номер блока и признак записи
+unsigned long long tagOf(size_t slot, bool isWrite) {
+    return (slot << 1) | (isWrite ? 1 : 0);
+}
+
+bool filterStreamUring(const Filter& filter, unsigned long long& bytesIn, unsigned long long& bytesOut) {
+    Ring ring;
+    if (!ringInit(ring, URING_SLOTS * 4)) return false;
+
+    // Обычные файлы читаются и пишутся по явным смещениям, и операций в полёте может быть
+    // сколько угодно; у пайпа порядок одновременных операций не гарантирован, поэтому по одной
+    struct stat info;
+    bool inputIsFile = fstat(STDIN_FILENO, &info) == 0 && S_ISREG(info.st_mode);
+    bool outputIsFile = fstat(STDOUT_FILENO, &info) == 0 && S_ISREG(info.st_mode);
+    off_t readBase = inputIsFile ? lseek(STDIN_FILENO, 0, SEEK_CUR) : -1;
+    off_t writeOffset = outputIsFile ? lseek(STDOUT_FILENO, 0, SEEK_CUR) : -1;
+    inputIsFile = inputIsFile && readBase != -1;
+    outputIsFile = outputIsFile && writeOffset != -1;
+    const unsigned readDepth = inputIsFile ? URING_SLOTS : 1;
+    const unsigned writeDepth = outputIsFile ? URING_SLOTS : 1;
+
+    Slot slots[URING_SLOTS];
+    iovec buffers[URING_SLOTS * 2];
+    for (size_t i = 0; i < URING_SLOTS; ++i) {
+        slots[i].state = SLOT_FREE;
+        // Лишняя страница вмещает и место под хвост перед входом, и этот хвост в выводе
+        slots[i].in = (char*)aligned_alloc(4096, URING_CHUNK + 4096);
+        slots[i].out = (char*)aligned_alloc(4096, URING_CHUNK + 4096);
+        if (slots[i].in == NULL || slots[i].out == NULL) fail("Out of memory\n");
+        buffers[2 * i] = {slots[i].in, URING_CHUNK + 4096};
+        buffers[2 * i + 1] = {slots[i].out, URING_CHUNK + 4096};
+    }
+    // Без регистрации (например, упёрлись в RLIMIT_MEMLOCK) работают обычные READ/WRITE
+    bool fixed = syscall(__NR_io_uring_register, ring.fd, IORING_REGISTER_BUFFERS, buffers, URING_SLOTS * 2) == 0;
+    // Иначе первое же чтение вернулось бы с -EINVAL, а вход уже не отдать обычному пути
+    if (!ringSupports(ring, fixed)) {
+        ringDestroy(ring);
+        for (Slot& slot : slots) {
+            free(slot.in);
+            free(slot.out);
+        }
+        return false;
+    }
+
+    auto submitRead = [&](size_t index) {
+        Slot& slot = slots[index];
+        io_uring_sqe* sqe = ringSqe(ring);
+        sqe->opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe->fd = STDIN_FILENO;
+        sqe->addr = (unsigned long long)(slot.in + URING_HEADROOM + slot.filled);
+        sqe->len = URING_CHUNK - slot.filled;
+        sqe->off = inputIsFile ? readBase + slot.seq * URING_CHUNK + slot.filled : (unsigned long long)-1;
+        sqe->buf_index = 2 * index;
+        sqe->user_data = tagOf(index, false);
+    };
+    auto submitWrite = [&](size_t index) {
+        Slot& slot = slots[index];
+        io_uring_sqe* sqe = ringSqe(ring);
+        sqe->opcode = fixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+        sqe->fd = STDOUT_FILENO;
+        sqe->addr = (unsigned long long)(slot.out + slot.written);
+        sqe->len = slot.outLen - slot.written;
+        sqe->off = slot.outOffset == -1 ? (unsigned long long)-1 : slot.outOffset + slot.written;
+        sqe->buf_index = 2 * index + 1;
+        sqe->user_data = tagOf(index, true);
+    };
+
+    char carry[URING_HEADROOM];
+    size_t carryLen = 0;
+    unsigned long long nextRead = 0, nextFilter = 0, nextWrite = 0;
+    unsigned long long endSeq = ~0ULL; // Номер первого блока после конца вывода
+    unsigned readsInFlight = 0, writesInFlight = 0;
+    bool inputEnded = false;
+    while (true) {
+        // Чтения вперёд в свободные блоки
+        while (!inputEnded && readsInFlight < readDepth && slots[nextRead % URING_SLOTS].state == SLOT_FREE) {
+            size_t index = nextRead % URING_SLOTS;
+            slots[index].state = SLOT_READING;
+            slots[index].seq = nextRead++;
+            slots[index].filled = 0;
+            submitRead(index);
+            readsInFlight++;
+        }
+        // Фильтр идёт строго по порядку блоков; пустой блок означает конец входа
+        while (nextFilter < endSeq && slots[nextFilter % URING_SLOTS].state == SLOT_READY) {
+            Slot& slot = slots[nextFilter % URING_SLOTS];
+            if (slot.filled == 0) {
+                // Оборванная концом входа последовательность выводится как есть
+                memcpy(slot.out, carry, carryLen);
+                slot.outLen = carryLen;
+                carryLen = 0;
+                endSeq = slot.outLen > 0 ? nextFilter + 1 : nextFilter;
+                if (slot.outLen == 0) slot.state = SLOT_FREE;
+            } else {
+                char* data = slot.in + URING_HEADROOM - carryLen;
+                memcpy(data, carry, carryLen);
+                size_t length = carryLen + slot.filled, consumed;
+                slot.outLen = filter.apply(data, length, slot.out, consumed);
+                carryLen = length - consumed;
+                memcpy(carry, data + consumed, carryLen);
+                bytesIn += slot.filled;
+            }
+            if (slot.state == SLOT_READY) {
+                slot.state = SLOT_FILTERED;
+                slot.written = 0;
+                slot.outOffset = outputIsFile ? writeOffset : -1;
+                writeOffset += slot.outLen;
+                bytesOut += slot.outLen;
+            }
+            nextFilter++;
+        }
+        // Записи в порядке блоков
+        while (nextWrite < nextFilter && writesInFlight < writeDepth) {
+            size_t index = nextWrite % URING_SLOTS;
+            if (slots[index].state != SLOT_FILTERED) break;
+            nextWrite++;
+            if (slots[index].outLen == 0) {
+                slots[index].state = SLOT_FREE;
+                continue;
+            }
+            slots[index].state = SLOT_WRITING;
+            submitWrite(index);
+            writesInFlight++;
+        }
+        if (nextWrite == endSeq && readsInFlight == 0 && writesInFlight == 0) break;
+
+        ringSubmit(ring, true);
+        unsigned head = *ring.cqHead;
+        unsigned tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = ring.cqes[head & ring.cqMask];
+            size_t index = cqe.user_data >> 1;
+            Slot& slot = slots[index];
+            if (cqe.user_data & 1) {
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    submitWrite(index);
+                    continue;
+                }
+                if (cqe.res <= 0) fail("Write failed\n");
+                slot.written += cqe.res;
+                if (slot.written < slot.outLen) {
+                    submitWrite(index); // Частичная запись: дописываем остаток
+                    continue;
+                }
+                slot.state = SLOT_FREE;
+                writesInFlight--;
+            } else {
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    submitRead(index);
+                    continue;
+                }
+                if (cqe.res < 0) fail("Read failed\n");
+                slot.filled += cqe.res;
+                // Файл дочитывается до полного блока, пайп отдаёт сколько есть
+                if (inputIsFile && cqe.res > 0 && slot.filled < URING_CHUNK) {
+                    submitRead(index);
+                    continue;
+                }
+                // Конец входа отмечает пустой блок; дочитанный до конца файла блок непуст,
+                // и пустым окажется следующий
+                if (slot.filled == 0) inputEnded = true;
+                slot.state = SLOT_READY;
+                readsInFlight--;
+            }
+        }
+        __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+        // Блоки, прочитанные за концом файла, больше не нужны
+        if (endSeq != ~0ULL) {
+            for (Slot& slot : slots) {
+                if (slot.state == SLOT_READY && slot.seq >= endSeq) slot.state = SLOT_FREE;
+            }
+        }
+    }
+
+    // Позиции дескрипторов сдвигаются так, как их сдвинули бы обычные read и write
+    if (inputIsFile) lseek(STDIN_FILENO, readBase + bytesIn, SEEK_SET);
+    if (outputIsFile) lseek(STDOUT_FILENO, writeOffset, SEEK_SET);
+    ringDestroy(ring);
+    for (Slot& slot : slots) {
+        free(slot.in);
+        free(slot.out);
+    }
+    return true;
+}
@@ -0,0 +1,15 @@
+#ifndef URING_STREAM_H
+#define URING_STREAM_H
+
+#include "filter_library.h"
+
+// Помощник из remove_vowels.cpp
+void fail(const char* errorMsg);
+
+// Потоковый режим stdin -> stdout на io_uring: несколько чтений и записей в полёте, так что
+// фильтрация блока N идёт одновременно с чтением N+1 и записью N-1. Возвращает false, ничего
+// не прочитав, если io_uring недоступен (старое ядро, запрет seccomp) или ядро не умеет нужных
+// операций чтения и записи - тогда нужен обычный путь.
+bool filterStreamUring(const Filter& filter, unsigned long long& bytesIn, unsigned long long& bytesOut);
+
+#endif // URING_STREAM_H
@@ -2,192 +2,555 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <time.h>
-#include <limits.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
 
-// Глобальные переменные для синхронизации
-pthread_mutex_t min_max_mutex = PTHREAD_MUTEX_INITIALIZER;
-int global_min = INT_MAX;
-int global_max = INT_MIN;
+#include "matrix.h"
+#include "matrix_file.h"
+#include "matrix_writer.h"
+#include "median.h"
+#include "reduce.h"
+#include "tiles.h"
 
+// Что выводится для каждого кадра, кроме статистики
+typedef enum {
+    OUTPUT_TEXT,    // Исходная и обработанная матрицы текстом
+    OUTPUT_QUIET,   // Только статистика
+    OUTPUT_BINARY   // Обработанная матрица в формате matrix_file, статистика в stderr
+} OutputMode;
+
+// Параметры командной строки
+typedef struct {
+    int window_size;
+    int thread_count;
+    int print_stats;
+    int print_mean;
+    int count_above;
+    long long threshold;
+    int frame_count;
+    const char *input_path;     // Фильтр файла вместо сгенерированных матриц
+    const char *output_path;
+    const char *generate_path;  // Только записать случайную матрицу в файл
+    MatrixDtype dtype;
+    long memory_mb;             // Бюджет памяти на полосу при фильтре файла
+    OutputMode output;
+    BorderPolicy border;        // Что окно видит за краем матрицы
+} Options;
+
+// Ореол входной матрицы: половина окна, если за краем что-то есть
+int border_halo(const Options *options) {
+    return options->border == BORDER_SHRINK ? 0 : options->window_size / 2;
+}
+
+// Общие данные всех плиток одного прогона фильтра
+typedef struct {
+    const Matrix *matrix;
+    Matrix *result;
+    int window_size;          // Размер окна медианного фильтра
+    MedianScratch *scratch;   // Рабочая память, по одной на поток
+    ReductionSet *reductions; // Минимум, максимум и прочая статистика по потокам
+} FilterJob;
+
+void filter_tile(const Tile *tile, int worker, void *context) {
+    FilterJob *job = (FilterJob *)context;
+    median_filter(job->matrix, job->result, job->window_size, tile->row_begin, tile->row_end,
+                  tile->col_begin, tile->col_end, &job->scratch[worker]);
+
+    // Статистика по только что посчитанной плитке, пока она в кэше; без общих блокировок
+    reduction_rows(job->reductions, worker, job->result, tile->row_begin, tile->row_end,
+                   tile->col_begin, tile->col_end);
+}
+
+// Пул потоков и их рабочая память на всё время работы, а не на каждый кадр или полосу
 typedef struct {
-    int **matrix;
-    int **result;
-    int rows;         // Кол-во строк
-    int cols;         // Кол-во столбцов
-    int window_size;  // Размер окна медианного фильтра
-    int start_row;
-    int end_row;
-} ThreadData;
-
-int compare(const void *a, const void *b) {
-    return (*(int *)a - *(int *)b);
-}
-
-int **allocate_matrix(int rows, int cols) {
-    int **matrix = malloc(rows * sizeof(int *));
-    if (!matrix) {
-        write(STDERR_FILENO, "Ошибка выделения памяти для строк матрицы\n", 42);
+    TilePool *pool;
+    int thread_count;
+    MedianScratch *scratch;
+    WorkerStats *stats;
+    WorkerStats *totals;   // Сумма по всем прогонам
+} Workers;
+
+void workers_init(Workers *workers, int thread_count, int window_size) {
+    workers->thread_count = thread_count;
+    workers->scratch = malloc(thread_count * sizeof(MedianScratch));
+    workers->stats = malloc(thread_count * sizeof(WorkerStats));
+    workers->totals = calloc(thread_count, sizeof(WorkerStats));
+    if (!workers->scratch || !workers->stats || !workers->totals) {
+        write(STDERR_FILENO, "Ошибка выделения памяти для потоков\n", 67);
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < rows; i++) {
-        matrix[i] = malloc(cols * sizeof(int));
-        if (!matrix[i]) {
-            write(STDERR_FILENO, "Ошибка выделения памяти для столбцов матрицы\n", 46);
-            exit(EXIT_FAILURE);
-        }
+    for (int i = 0; i < thread_count; i++) {
+        median_scratch_init(&workers->scratch[i], window_size);
     }
-    return matrix;
+    workers->pool = tile_pool_create(thread_count);
 }
 
-void free_matrix(int **matrix, int rows) {
-    for (int i = 0; i < rows; i++) {
-        free(matrix[i]);
+// Плитки раздаются потокам пула, освободившиеся потоки забирают чужие
+void workers_run(Workers *workers, const Tile *tiles, int tile_count, FilterJob *job) {
+    job->scratch = workers->scratch;
+    tile_pool_run(workers->pool, tiles, tile_count, filter_tile, job, workers->stats);
+    for (int i = 0; i < workers->thread_count; i++) {
+        workers->totals[i].tiles += workers->stats[i].tiles;
+        workers->totals[i].stolen += workers->stats[i].stolen;
+        workers->totals[i].busy += workers->stats[i].busy;
+        workers->totals[i].wall += workers->stats[i].wall;
     }
-    free(matrix);
 }
 
-void apply_median_filter(ThreadData *data) {
-    int w = data->window_size;
-    int half_w = w / 2;
-    int size = w * w;
-    int *window = malloc(size * sizeof(int));
-    if (!window) {
-        write(STDERR_FILENO, "Ошибка выделения памяти для окна\n", 33);
-        exit(EXIT_FAILURE);
+void workers_report(const Workers *workers) {
+    char buffer[256];
+    for (int i = 0; i < workers->thread_count; i++) {
+        const WorkerStats *total = &workers->totals[i];
+        int offset = snprintf(buffer, sizeof(buffer), "Поток %d: плиток %ld (украдено %ld), занят %.3f с из %.3f с (%.0f%%)\n",
+                              i + 1, total->tiles, total->stolen, total->busy, total->wall,
+                              total->wall > 0 ? total->busy / total->wall * 100 : 0.0);
+        write(STDERR_FILENO, buffer, offset);
     }
+}
 
-    for (int i = data->start_row; i < data->end_row; i++) {
-        for (int j = 0; j < data->cols; j++) {
-            int count = 0;
-            for (int ki = -half_w; ki <= half_w; ki++) {
-                for (int kj = -half_w; kj <= half_w; kj++) {
-                    int ni = i + ki, nj = j + kj;
-                    if (ni >= 0 && ni < data->rows && nj >= 0 && nj < data->cols) {
-                        window[count++] = data->matrix[ni][nj];
-                    }
-                }
-            }
-            qsort(window, count, sizeof(int), compare);
-            data->result[i][j] = window[count / 2];
-
-            // Обновляем глобальные минимумы и максимумы
-            int value = window[count / 2];
-            pthread_mutex_lock(&min_max_mutex);
-            if (value < global_min) global_min = value;
-            if (value > global_max) global_max = value;
-            pthread_mutex_unlock(&min_max_mutex);
-        }
+void workers_free(Workers *workers) {
+    tile_pool_destroy(workers->pool);
+    for (int i = 0; i < workers->thread_count; i++) {
+        median_scratch_free(&workers->scratch[i]);
     }
+    free(workers->scratch);
+    free(workers->stats);
+    free(workers->totals);
+}
+
+// Какие свёртки подключены и где лежат их результаты в наборе
+typedef struct {
+    int min_max_index;
+    int mean_index;
+    int above_index;
+    Reduction above;
+} Statistics;
+
+void statistics_init(Statistics *statistics, const Options *options) {
+    statistics->above = reduction_above;
+    statistics->above.parameter = options->threshold;
+    statistics->mean_index = options->print_mean ? 0 : -1;
+    statistics->above_index = options->count_above ? 0 : -1;
+}
+
+void statistics_attach(Statistics *statistics, ReductionSet *reductions, int thread_count) {
+    reduction_set_init(reductions);
+    statistics->min_max_index = reduction_add(reductions, &reduction_min_max);
+    if (statistics->mean_index >= 0) statistics->mean_index = reduction_add(reductions, &reduction_mean);
+    if (statistics->above_index >= 0) statistics->above_index = reduction_add(reductions, &statistics->above);
+    reduction_prepare(reductions, thread_count);
+}
 
-    free(window);
+void print_statistics(const Statistics *statistics, const ReductionSet *reductions, int fd) {
+    char buffer[256];
+    int offset = 0;
+    // Вывод глобальных минимального и максимального значений
+    const MinMaxState *min_max = (const MinMaxState *)reduction_result(reductions, statistics->min_max_index);
+    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "Глобальный минимум: %d\n", min_max->min);
+    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "Глобальный максимум: %d\n", min_max->max);
+    if (statistics->mean_index >= 0) {
+        const MeanState *mean = (const MeanState *)reduction_result(reductions, statistics->mean_index);
+        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "Среднее: %.3f\n",
+                           mean->count ? (double)mean->sum / mean->count : 0.0);
+    }
+    if (statistics->above_index >= 0) {
+        const AboveState *count = (const AboveState *)reduction_result(reductions, statistics->above_index);
+        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "Больше %lld: %lld\n",
+                           statistics->above.parameter, count->count);
+    }
+    write(fd, buffer, offset);
 }
 
-void *thread_function(void *arg) {
-    ThreadData *data = (ThreadData *)arg;
-    apply_median_filter(data);
+// Кадры в работе одновременно: пока пул фильтрует кадр k, генератор заполняет k + 1,
+// а писатель выводит k - 1, поэтому у каждой пары соседних стадий свой двойной буфер
+#define FRAME_BUFFERS 3
+
+typedef enum {
+    FRAME_FREE,      // Можно заполнять
+    FRAME_LOADED,    // Вход готов, ждёт фильтра
+    FRAME_FILTERED   // Результат и статистика готовы, ждут вывода
+} FrameState;
+
+typedef struct {
+    Matrix matrix;
+    Matrix result;
+    ReductionSet reductions;
+    FrameState state;
+} Frame;
+
+// Поток кадров: генератор -> пул потоков фильтра -> писатель, каждая стадия в своём потоке
+typedef struct {
+    Frame frames[FRAME_BUFFERS];
+    int frame_count;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    Statistics statistics;   // Что выводить для каждого кадра
+    OutputMode output;
+    MatrixWriter *writer;    // Матрицы в stdout
+    BorderPolicy border;
+} FramePipeline;
+
+// Ждёт, пока кадр k перейдёт в состояние state
+Frame *wait_frame(FramePipeline *pipeline, int k, FrameState state) {
+    Frame *frame = &pipeline->frames[k % FRAME_BUFFERS];
+    pthread_mutex_lock(&pipeline->lock);
+    while (frame->state != state) pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+    pthread_mutex_unlock(&pipeline->lock);
+    return frame;
+}
+
+void set_frame(FramePipeline *pipeline, Frame *frame, FrameState state) {
+    pthread_mutex_lock(&pipeline->lock);
+    frame->state = state;
+    pthread_cond_broadcast(&pipeline->changed);
+    pthread_mutex_unlock(&pipeline->lock);
+}
+
+void fill_random(Matrix *matrix, int limit) {
+    for (int i = 0; i < matrix->rows; i++) {
+        int *row = matrix_row(matrix, i);
+        for (int j = 0; j < matrix->cols; j++) {
+            row[j] = rand() % limit;
+        }
+    }
+}
+
+void *generator_thread(void *arg) {
+    FramePipeline *pipeline = (FramePipeline *)arg;
+    for (int k = 0; k < pipeline->frame_count; k++) {
+        Frame *frame = wait_frame(pipeline, k, FRAME_FREE);
+        fill_random(&frame->matrix, 1000);
+        matrix_fill_halo(&frame->matrix, pipeline->border);
+        set_frame(pipeline, frame, FRAME_LOADED);
+    }
     return NULL;
 }
 
-int str_to_int(const char *str) {
-    char *endptr;
-    int value = strtol(str, &endptr, 10);
-    if (*endptr != '\0') {
-        write(STDERR_FILENO, "Ошибка: некорректный ввод числа\n", 31);
-        exit(EXIT_FAILURE);
+void print_frame(const FramePipeline *pipeline, int k, const Frame *frame) {
+    // В двоичном режиме stdout занят матрицами, текст уходит в stderr
+    int text_fd = pipeline->output == OUTPUT_BINARY ? STDERR_FILENO : STDOUT_FILENO;
+    if (pipeline->frame_count > 1) {
+        char buffer[64];
+        int offset = snprintf(buffer, sizeof(buffer), "Кадр %d:\n", k + 1);
+        write(text_fd, buffer, offset);
     }
-    return value;
+    if (pipeline->output == OUTPUT_TEXT) {
+        matrix_writer_text(pipeline->writer, "Исходная матрица:\n", &frame->matrix);
+        matrix_writer_text(pipeline->writer, "Обработанная матрица:\n", &frame->result);
+    } else if (pipeline->output == OUTPUT_BINARY) {
+        matrix_writer_binary(pipeline->writer, &frame->result);
+    }
+    print_statistics(&pipeline->statistics, &frame->reductions, text_fd);
 }
 
-int main(int argc, char *argv[]) {
-    if (argc != 5) {
-        write(STDERR_FILENO, "Использование: ./program <строки> <столбцы> <размер_окна> <потоки>\n", 68);
-        return EXIT_FAILURE;
+void *writer_thread(void *arg) {
+    FramePipeline *pipeline = (FramePipeline *)arg;
+    for (int k = 0; k < pipeline->frame_count; k++) {
+        Frame *frame = wait_frame(pipeline, k, FRAME_FILTERED);
+        print_frame(pipeline, k, frame);
+        set_frame(pipeline, frame, FRAME_FREE);
+    }
+    return NULL;
+}
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void print_tiles(const Tile *tiles, int tile_count) {
+    char buffer[128];
+    int offset = snprintf(buffer, sizeof(buffer), "Плиток: %d, %d x %d\n", tile_count,
+                          tiles[0].row_end - tiles[0].row_begin, tiles[0].col_end - tiles[0].col_begin);
+    write(STDERR_FILENO, buffer, offset);
+}
+
+// Сгенерированные матрицы: один кадр или поток из frame_count кадров
+void run_frames(int rows, int cols, const Options *options) {
+    FramePipeline pipeline;
+    pipeline.frame_count = options->frame_count;
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+    statistics_init(&pipeline.statistics, options);
+    pipeline.output = options->output;
+    pipeline.border = options->border;
+    // Текст форматируют столько же потоков, сколько фильтруют: у писателя свой пул
+    pipeline.writer = matrix_writer_create(STDOUT_FILENO, options->output == OUTPUT_TEXT ? options->thread_count : 1);
+    int buffers = options->frame_count < FRAME_BUFFERS ? options->frame_count : FRAME_BUFFERS;
+    for (int k = 0; k < buffers; k++) {
+        Frame *frame = &pipeline.frames[k];
+        frame->matrix = allocate_matrix_halo(rows, cols, border_halo(options));
+        frame->result = allocate_matrix(rows, cols);
+        frame->state = FRAME_FREE;
+        statistics_attach(&pipeline.statistics, &frame->reductions, options->thread_count);
     }
 
-    int rows = str_to_int(argv[1]);
-    int cols = str_to_int(argv[2]);
-    int window_size = str_to_int(argv[3]);
-    int thread_count = str_to_int(argv[4]);
+    // Плитки размером под L2, одни и те же для всех кадров
+    int tile_count;
+    Tile *tiles = make_tiles(rows, cols, options->window_size, options->thread_count, &tile_count);
+    Workers workers;
+    workers_init(&workers, options->thread_count, options->window_size);
 
-    if (rows <= 0 || cols <= 0 || window_size <= 0 || thread_count <= 0) {
-        write(STDERR_FILENO, "Ошибка: недопустимые значения аргументов\n", 41);
-        return EXIT_FAILURE;
+    srand(time(NULL));
+    double start = now_seconds();
+    pthread_t generator, writer;
+    if (pthread_create(&generator, NULL, generator_thread, &pipeline) != 0 ||
+        pthread_create(&writer, NULL, writer_thread, &pipeline) != 0) {
+        write(STDERR_FILENO, "Ошибка создания потока\n", 43);
+        exit(EXIT_FAILURE);
     }
 
-    int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
-    if (thread_count > max_threads) {
-        thread_count = max_threads;
+    for (int k = 0; k < options->frame_count; k++) {
+        Frame *frame = wait_frame(&pipeline, k, FRAME_LOADED);
+        reduction_reset(&frame->reductions);
+        FilterJob job = {&frame->matrix, &frame->result, options->window_size, NULL, &frame->reductions};
+        workers_run(&workers, tiles, tile_count, &job);
+        reduction_finish(&frame->reductions);
+        set_frame(&pipeline, frame, FRAME_FILTERED);
+    }
+
+    if (pthread_join(generator, NULL) != 0 || pthread_join(writer, NULL) != 0) {
+        write(STDERR_FILENO, "Ошибка завершения потока\n", 47);
+        exit(EXIT_FAILURE);
     }
+    double elapsed = now_seconds() - start;
 
-    int **matrix = allocate_matrix(rows, cols);
-    int **result = allocate_matrix(rows, cols);
+    if (options->print_stats) {
+        workers_report(&workers);
+        print_tiles(tiles, tile_count);
+        char buffer[128];
+        int offset = snprintf(buffer, sizeof(buffer), "Кадров: %d за %.3f с, %.1f кадров/с\n", options->frame_count,
+                              elapsed, elapsed > 0 ? options->frame_count / elapsed : 0.0);
+        write(STDERR_FILENO, buffer, offset);
+    }
+
+    workers_free(&workers);
+    matrix_writer_destroy(pipeline.writer);
+    free(tiles);
+    for (int k = 0; k < buffers; k++) {
+        free_matrix(&pipeline.frames[k].matrix);
+        free_matrix(&pipeline.frames[k].result);
+        reduction_set_free(&pipeline.frames[k].reductions);
+    }
+    pthread_mutex_destroy(&pipeline.lock);
+    pthread_cond_destroy(&pipeline.changed);
+}
 
+// Случайная матрица сразу в файл, полосами, чтобы не держать её в памяти целиком
+void run_generate(int rows, int cols, const Options *options) {
+    MatrixFile file;
+    matrix_file_create(&file, options->generate_path, rows, cols, options->dtype);
+    int limit = options->dtype == MATRIX_UINT8 ? 256 : 1000;
+    int band = (int)(options->memory_mb * 1024 * 1024 / ((long)cols * sizeof(int)));
+    if (band < 1) band = 1;
+    if (band > rows) band = rows;
+    Matrix buffer = allocate_matrix(band, cols);
     srand(time(NULL));
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            matrix[i][j] = rand() % 1000;
-        }
+    for (int r0 = 0; r0 < rows; r0 += band) {
+        int count = rows - r0 < band ? rows - r0 : band;
+        fill_random(&buffer, limit);
+        matrix_file_write_rows(&file, r0, count, &buffer, 0);
+        matrix_file_advise(&file, r0, count, MADV_DONTNEED);
     }
+    free_matrix(&buffer);
+    matrix_file_close(&file);
+}
 
-    char buffer[1024];
-    int offset = 0;
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "Исходная матрица:\n");
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            offset += snprintf(buffer + offset, sizeof(buffer) - offset, "%3d ", matrix[i][j]);
+// Фильтр файла, который может не помещаться в память. Матрица идёт полосами строк:
+// полоса читается вместе с half строками ореола сверху и снизу, так что окно обрезается
+// только на настоящих краях матрицы. Рабочий набор - две полосы в памяти независимо
+// от размера файла; следующая полоса заранее подгружается MADV_WILLNEED, а пройденные
+// страницы входа и выхода отпускаются MADV_DONTNEED.
+void run_file(const Options *options) {
+    MatrixFile input, output;
+    matrix_file_open(&input, options->input_path);
+    int rows = (int)input.header.rows;
+    int cols = (int)input.header.cols;
+    matrix_file_create(&output, options->output_path, rows, cols, (MatrixDtype)input.header.dtype);
+
+    int half = options->window_size / 2;
+    long row_bytes = (long)(cols + MATRIX_ALIGNMENT) * sizeof(int);
+    long band = options->memory_mb * 1024 * 1024 / (2 * row_bytes) - 2 * half;
+    if (band < 1) band = 1;
+    if (band > rows) band = rows;
+    Matrix source = allocate_matrix_halo((int)band + 2 * half, cols, border_halo(options));
+    Matrix result = allocate_matrix((int)band + 2 * half, cols);
+
+    Statistics statistics;
+    statistics_init(&statistics, options);
+    ReductionSet reductions;
+    statistics_attach(&statistics, &reductions, options->thread_count);
+    Workers workers;
+    workers_init(&workers, options->thread_count, options->window_size);
+
+    double start = now_seconds();
+    int total_tiles = 0;
+    for (int r0 = 0; r0 < rows; r0 += (int)band) {
+        int r1 = r0 + band < rows ? r0 + (int)band : rows;
+        int lo = r0 - half < 0 ? 0 : r0 - half;
+        int hi = r1 + half > rows ? rows : r1 + half;
+        if (hi < rows) {
+            int next_hi = hi + (int)band < rows ? hi + (int)band : rows;
+            matrix_file_advise(&input, hi, next_hi - hi, MADV_WILLNEED);
         }
-        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "\n");
+
+        // Вид на полосу: строка 0 - это строка lo матрицы
+        source.rows = result.rows = hi - lo;
+        matrix_file_read_rows(&input, lo, hi - lo, &source, 0);
+        // Ореол полосы читается только на настоящих краях матрицы: у внутренних полос
+        // окно не выходит за строки, прочитанные из файла
+        matrix_fill_halo(&source, options->border);
+        // Следующей полосе нужны строки начиная с r1 - half, всё выше можно отпустить
+        matrix_file_advise(&input, lo, r1 - half - lo, MADV_DONTNEED);
+
+        int tile_count;
+        Tile *tiles = make_tiles(r1 - r0, cols, options->window_size, options->thread_count, &tile_count);
+        for (int t = 0; t < tile_count; t++) {
+            tiles[t].row_begin += r0 - lo;
+            tiles[t].row_end += r0 - lo;
+        }
+        FilterJob job = {&source, &result, options->window_size, NULL, &reductions};
+        workers_run(&workers, tiles, tile_count, &job);
+        total_tiles += tile_count;
+        free(tiles);
+
+        matrix_file_write_rows(&output, r0, r1 - r0, &result, r0 - lo);
+        matrix_file_advise(&output, r0, r1 - r0, MADV_DONTNEED);
     }
-    write(STDOUT_FILENO, buffer, offset);
+    reduction_finish(&reductions);
+    double elapsed = now_seconds() - start;
 
-    pthread_t threads[thread_count];
-    ThreadData thread_data[thread_count];
+    print_statistics(&statistics, &reductions, STDOUT_FILENO);
+    if (options->print_stats) {
+        workers_report(&workers);
+        char buffer[160];
+        int offset = snprintf(buffer, sizeof(buffer), "Полос: %ld строк, плиток %d, %.3f с, %.1f МБ/с\n", band,
+                              total_tiles, elapsed, elapsed > 0 ? (double)rows * cols * sizeof(int) / elapsed / 1e6 : 0.0);
+        write(STDERR_FILENO, buffer, offset);
+    }
 
-    int rows_per_thread = rows / thread_count;
+    workers_free(&workers);
+    reduction_set_free(&reductions);
+    free_matrix(&source);
+    free_matrix(&result);
+    matrix_file_close(&input);
+    matrix_file_close(&output);
+}
 
-    for (int i = 0; i < thread_count; i++) {
-        thread_data[i].matrix = matrix;
-        thread_data[i].result = result;
-        thread_data[i].rows = rows;
-        thread_data[i].cols = cols;
-        thread_data[i].window_size = window_size;
-        thread_data[i].start_row = i * rows_per_thread;
-        thread_data[i].end_row = (i == thread_count - 1) ? rows : (i + 1) * rows_per_thread;
-
-        if (pthread_create(&threads[i], NULL, thread_function, &thread_data[i]) != 0) {
-            write(STDERR_FILENO, "Ошибка создания потока\n", 23);
-            return EXIT_FAILURE;
-        }
+int str_to_int(const char *str) {
+    char *endptr;
+    int value = strtol(str, &endptr, 10);
+    if (*endptr != '\0') {
+        write(STDERR_FILENO, "Ошибка: некорректный ввод числа\n", 31);
+        exit(EXIT_FAILURE);
     }
+    return value;
+}
 
-    for (int i = 0; i < thread_count; i++) {
-        if (pthread_join(threads[i], NULL) != 0) {
-            write(STDERR_FILENO, "Ошибка завершения потока\n", 25);
+void usage(void) {
+    const char *text =
+        "Использование: ./program <строки> <столбцы> <размер_окна> <потоки> [--stats] [--mean] [--above N] [--frames N]\n"
+        "                    [--quiet | --binary] [--border shrink|clamp|mirror]\n"
+        "               ./program <размер_окна> <потоки> --input ФАЙЛ --output ФАЙЛ [--memory МБ] [--stats] [--mean] [--above N]\n"
+        "                    [--border shrink|clamp|mirror]\n"
+        "               ./program <строки> <столбцы> --generate ФАЙЛ [--dtype i32|u16|u8]\n";
+    write(STDERR_FILENO, text, strlen(text));
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char *argv[]) {
+    Options options = {0, 0, 0, 0, 0, 0, 1, NULL, NULL, NULL, MATRIX_INT32, 256, OUTPUT_TEXT, BORDER_SHRINK};
+    const char *positional[4];
+    int positional_count = 0;
+    for (int i = 1; i < argc; i++) {
+        int has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--stats") == 0) {
+            options.print_stats = 1;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            options.output = OUTPUT_QUIET;
+        } else if (strcmp(argv[i], "--binary") == 0) {
+            options.output = OUTPUT_BINARY;
+        } else if (strcmp(argv[i], "--mean") == 0) {
+            options.print_mean = 1;
+        } else if (strcmp(argv[i], "--above") == 0 && has_value) {
+            options.count_above = 1;
+            options.threshold = str_to_int(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && has_value) {
+            options.frame_count = str_to_int(argv[++i]);
+        } else if (strcmp(argv[i], "--input") == 0 && has_value) {
+            options.input_path = argv[++i];
+        } else if (strcmp(argv[i], "--output") == 0 && has_value) {
+            options.output_path = argv[++i];
+        } else if (strcmp(argv[i], "--generate") == 0 && has_value) {
+            options.generate_path = argv[++i];
+        } else if (strcmp(argv[i], "--memory") == 0 && has_value) {
+            options.memory_mb = str_to_int(argv[++i]);
+        } else if (strcmp(argv[i], "--border") == 0 && has_value) {
+            i++;
+            if (strcmp(argv[i], "shrink") == 0) {
+                options.border = BORDER_SHRINK;
+            } else if (strcmp(argv[i], "clamp") == 0) {
+                options.border = BORDER_CLAMP;
+            } else if (strcmp(argv[i], "mirror") == 0) {
+                options.border = BORDER_MIRROR;
+            } else {
+                usage();
+            }
+        } else if (strcmp(argv[i], "--dtype") == 0 && has_value) {
+            i++;
+            if (strcmp(argv[i], "i32") == 0) {
+                options.dtype = MATRIX_INT32;
+            } else if (strcmp(argv[i], "u16") == 0) {
+                options.dtype = MATRIX_UINT16;
+            } else if (strcmp(argv[i], "u8") == 0) {
+                options.dtype = MATRIX_UINT8;
+            } else {
+                usage();
+            }
+        } else if (argv[i][0] != '-' && positional_count < 4) {
+            positional[positional_count++] = argv[i];
+        } else {
+            write(STDERR_FILENO, "Ошибка: неизвестный параметр\n", 54);
             return EXIT_FAILURE;
         }
     }
 
-    offset = 0;
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "Обработанная матрица:\n");
-    for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            offset += snprintf(buffer + offset, sizeof(buffer) - offset, "%3d ", result[i][j]);
+    if (options.generate_path) {
+        if (positional_count != 2) usage();
+        int rows = str_to_int(positional[0]);
+        int cols = str_to_int(positional[1]);
+        if (rows <= 0 || cols <= 0 || options.memory_mb <= 0) {
+            write(STDERR_FILENO, "Ошибка: недопустимые значения аргументов\n", 41);
+            return EXIT_FAILURE;
         }
-        offset += snprintf(buffer + offset, sizeof(buffer) - offset, "\n");
+        run_generate(rows, cols, &options);
+        return EXIT_SUCCESS;
     }
-    write(STDOUT_FILENO, buffer, offset);
 
-    // Вывод глобальных минимального и максимального значений
-    offset = 0;
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "Глобальный минимум: %d\n", global_min);
-    offset += snprintf(buffer + offset, sizeof(buffer) - offset, "Глобальный максимум: %d\n", global_max);
-    write(STDOUT_FILENO, buffer, offset);
+    int file_mode = options.input_path != NULL;
+    if (file_mode != (options.output_path != NULL) || positional_count != (file_mode ? 2 : 4)) usage();
+    int rows = file_mode ? 1 : str_to_int(positional[0]);
+    int cols = file_mode ? 1 : str_to_int(positional[1]);
+    options.window_size = str_to_int(positional[file_mode ? 0 : 2]);
+    options.thread_count = str_to_int(positional[file_mode ? 1 : 3]);
 
-    free_matrix(matrix, rows);
-    free_matrix(result, rows);
+    if (rows <= 0 || cols <= 0 || options.window_size <= 0 || options.thread_count <= 0 ||
+        options.frame_count <= 0 || options.memory_mb <= 0) {
+        write(STDERR_FILENO, "Ошибка: недопустимые значения аргументов\n", 41);
+        return EXIT_FAILURE;
+    }
 
-    pthread_mutex_destroy(&min_max_mutex);
+    int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    if (options.thread_count > max_threads) {
+        options.thread_count = max_threads;
+    }
 
+    if (file_mode) {
+        run_file(&options);
+    } else {
+        run_frames(rows, cols, &options);
+    }
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,82 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "matrix.h"
+
+// Отступ data от начала блока: halo строк и выровненный левый ореол
+static size_t halo_offset(const Matrix *matrix) {
+    const size_t per_line = MATRIX_ALIGNMENT / sizeof(int);
+    size_t left = ((size_t)matrix->halo + per_line - 1) / per_line * per_line;
+    return (size_t)matrix->halo * matrix->stride + left;
+}
+
+Matrix allocate_matrix_halo(int rows, int cols, int halo) {
+    const size_t per_line = MATRIX_ALIGNMENT / sizeof(int);
+    Matrix matrix;
+    matrix.rows = rows;
+    matrix.cols = cols;
+    matrix.halo = halo;
+    size_t left = ((size_t)halo + per_line - 1) / per_line * per_line;
+    matrix.stride = (left + (size_t)cols + halo + per_line - 1) / per_line * per_line;
+    size_t block_rows = (size_t)rows + 2 * (size_t)halo;
+    if (block_rows > SIZE_MAX / sizeof(int) / matrix.stride) {
+        write(STDERR_FILENO, "Ошибка: матрица слишком велика\n", 57);
+        exit(EXIT_FAILURE);
+    }
+    matrix.bytes = block_rows * matrix.stride * sizeof(int);
+
+    const char *huge_pages = getenv("MATRIX_HUGEPAGES");
+    int use_huge = matrix.bytes >= MATRIX_HUGE_PAGE && !(huge_pages && strcmp(huge_pages, "0") == 0);
+    void *data = NULL;
+    if (posix_memalign(&data, use_huge ? MATRIX_HUGE_PAGE : MATRIX_ALIGNMENT, matrix.bytes) != 0) {
+        write(STDERR_FILENO, "Ошибка выделения памяти для матрицы\n", 67);
+        exit(EXIT_FAILURE);
+    }
+#ifdef MADV_HUGEPAGE
+    if (use_huge) {
+        madvise(data, matrix.bytes, MADV_HUGEPAGE); // Подсказка: без поддержки THP просто игнорируется
+    }
+#endif
+    matrix.data = (int *)data + halo_offset(&matrix);
+    return matrix;
+}
+
+Matrix allocate_matrix(int rows, int cols) {
+    return allocate_matrix_halo(rows, cols, 0);
+}
+
+void free_matrix(Matrix *matrix) {
+    if (matrix->data) free(matrix->data - halo_offset(matrix));
+    matrix->data = NULL;
+}
+
+// Номер строки или столбца матрицы размера n, который виден на месте i
+static int border_index(int i, int n, BorderPolicy policy) {
+    if (policy == BORDER_CLAMP || n == 1) return i < 0 ? 0 : (i >= n ? n - 1 : i);
+    // Отражение без повтора края периодично с периодом 2 (n - 1)
+    int period = 2 * (n - 1);
+    i %= period;
+    if (i < 0) i += period;
+    return i < n ? i : period - i;
+}
+
+void matrix_fill_halo(Matrix *matrix, BorderPolicy policy) {
+    int halo = matrix->halo;
+    if (policy == BORDER_SHRINK || halo == 0) return;
+    for (int i = 0; i < matrix->rows; i++) {
+        int *row = matrix_row(matrix, i);
+        for (int j = -halo; j < 0; j++) row[j] = row[border_index(j, matrix->cols, policy)];
+        for (int j = matrix->cols; j < matrix->cols + halo; j++) row[j] = row[border_index(j, matrix->cols, policy)];
+    }
+    // Строки ореола копируются целиком вместе с уже заполненными углами
+    size_t width = ((size_t)matrix->cols + 2 * (size_t)halo) * sizeof(int);
+    for (int i = -halo; i < 0; i++) {
+        memcpy(matrix_row(matrix, i) - halo, matrix_row(matrix, border_index(i, matrix->rows, policy)) - halo, width);
+    }
+    for (int i = matrix->rows; i < matrix->rows + halo; i++) {
+        memcpy(matrix_row(matrix, i) - halo, matrix_row(matrix, border_index(i, matrix->rows, policy)) - halo, width);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef MATRIX_H
+#define MATRIX_H
+
+#include <stddef.h>
+
+// Выравнивание начала каждой строки: строка кэша
+#define MATRIX_ALIGNMENT 64
+// Большие матрицы выравниваются на огромную страницу и помечаются MADV_HUGEPAGE
+#define MATRIX_HUGE_PAGE (2 * 1024 * 1024)
+
+// Что окно видит за краем матрицы
+typedef enum {
+    BORDER_SHRINK,  // Ничего: окно обрезается по матрице, медиана из попавших в него
+    BORDER_CLAMP,   // Повтор крайнего значения: ... a a | a b c
+    BORDER_MIRROR   // Отражение без повтора края: ... c b | a b c
+} BorderPolicy;
+
+// Матрица одним непрерывным блоком: строка i начинается с data + i * stride,
+// stride округлён вверх до целой строки кэша, так что каждая строка выровнена.
+// Вокруг матрицы может быть ореол из halo строк и столбцов с каждой стороны: индексы
+// от -halo до rows + halo - 1 (и так же для столбцов) читаются, ореол заполняет
+// matrix_fill_halo. Фильтры считают ореол частью матрицы и обрезают окно только за ним.
+typedef struct {
+    int *data;
+    int rows;
+    int cols;
+    int halo;
+    size_t stride;  // Элементов между началами соседних строк
+    size_t bytes;   // Размер блока
+} Matrix;
+
+static inline int *matrix_row(const Matrix *matrix, int i) {
+    return matrix->data + (ptrdiff_t)i * (ptrdiff_t)matrix->stride;
+}
+
+#define MATRIX_AT(matrix, i, j) (matrix_row((matrix), (i))[(j)])
+
+// Одна выровненная аллокация вместо malloc на строку; при ошибке завершает программу.
+// Огромные страницы можно отключить переменной окружения MATRIX_HUGEPAGES=0.
+Matrix allocate_matrix(int rows, int cols);
+// То же с ореолом; левый ореол занимает целые строки кэша, чтобы строки остались выровнены
+Matrix allocate_matrix_halo(int rows, int cols, int halo);
+void free_matrix(Matrix *matrix);
+
+// Заполняет ореол из значений матрицы по правилу policy (BORDER_SHRINK ничего не делает).
+// Отражение повторяется, если ореол шире матрицы.
+void matrix_fill_halo(Matrix *matrix, BorderPolicy policy);
+
+#endif // MATRIX_H
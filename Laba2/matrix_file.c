@@ -0,0 +1,147 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "matrix_file.h"
+
+static void fail(const char *message) {
+    write(STDERR_FILENO, message, strlen(message));
+    exit(EXIT_FAILURE);
+}
+
+static size_t dtype_size(uint32_t dtype) {
+    switch (dtype) {
+    case MATRIX_INT32: return 4;
+    case MATRIX_UINT16: return 2;
+    case MATRIX_UINT8: return 1;
+    default: return 0;
+    }
+}
+
+static void map_file(MatrixFile *file, int prot) {
+    file->map = mmap(NULL, file->map_size, prot, MAP_SHARED, file->fd, 0);
+    if (file->map == MAP_FAILED) {
+        fail("Ошибка отображения файла матрицы в память\n");
+    }
+}
+
+void matrix_file_open(MatrixFile *file, const char *path) {
+    file->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (file->fd == -1) {
+        fail("Ошибка открытия файла матрицы\n");
+    }
+    struct stat info;
+    if (fstat(file->fd, &info) == -1 || (size_t)info.st_size < sizeof(MatrixFileHeader)) {
+        fail("Ошибка: файл матрицы слишком короткий\n");
+    }
+    if (pread(file->fd, &file->header, sizeof(file->header), 0) != (ssize_t)sizeof(file->header)) {
+        fail("Ошибка чтения заголовка матрицы\n");
+    }
+    const MatrixFileHeader *header = &file->header;
+    size_t element = dtype_size(header->dtype);
+    if (memcmp(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != MATRIX_FILE_VERSION || element == 0) {
+        fail("Ошибка: неизвестный формат файла матрицы\n");
+    }
+    // Размеры проверяются делением, а не умножением: испорченный заголовок не должен переполнить
+    // rows * stride и пройти проверку с выходом file_row за отображение. Строки и начало данных
+    // кратны размеру элемента, иначе чтение через uint16_t было бы невыровненным.
+    uint64_t file_size = (uint64_t)info.st_size;
+    if (header->rows == 0 || header->cols == 0 || header->rows > INT_MAX || header->cols > INT_MAX ||
+        header->stride < header->cols * element || header->stride % element != 0 ||
+        header->data_offset % element != 0 || header->data_offset > file_size ||
+        header->stride > (file_size - header->data_offset) / header->rows) {
+        fail("Ошибка: повреждённый заголовок матрицы\n");
+    }
+    file->map_size = info.st_size;
+    map_file(file, PROT_READ);
+}
+
+void matrix_file_header(MatrixFileHeader *header, int rows, int cols, MatrixDtype dtype) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic));
+    header->version = MATRIX_FILE_VERSION;
+    header->dtype = dtype;
+    header->rows = rows;
+    header->cols = cols;
+    header->stride = ((uint64_t)cols * dtype_size(dtype) + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+    header->data_offset = MATRIX_FILE_DATA_OFFSET;
+}
+
+void matrix_file_create(MatrixFile *file, const char *path, int rows, int cols, MatrixDtype dtype) {
+    MatrixFileHeader *header = &file->header;
+    matrix_file_header(header, rows, cols, dtype);
+    file->map_size = header->data_offset + header->rows * header->stride;
+
+    file->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file->fd == -1) {
+        fail("Ошибка создания файла матрицы\n");
+    }
+    if (ftruncate(file->fd, file->map_size) == -1) {
+        fail("Ошибка задания размера файла матрицы\n");
+    }
+    map_file(file, PROT_READ | PROT_WRITE);
+    memcpy(file->map, header, sizeof(*header));
+}
+
+void matrix_file_close(MatrixFile *file) {
+    munmap(file->map, file->map_size);
+    close(file->fd);
+}
+
+static unsigned char *file_row(const MatrixFile *file, int i) {
+    return file->map + file->header.data_offset + (size_t)i * file->header.stride;
+}
+
+void matrix_file_read_rows(const MatrixFile *file, int first, int count, Matrix *dst, int dst_row) {
+    int cols = (int)file->header.cols;
+    for (int k = 0; k < count; k++) {
+        const unsigned char *in = file_row(file, first + k);
+        int *out = matrix_row(dst, dst_row + k);
+        switch (file->header.dtype) {
+        case MATRIX_INT32:
+            memcpy(out, in, (size_t)cols * sizeof(int));
+            break;
+        case MATRIX_UINT16:
+            for (int j = 0; j < cols; j++) out[j] = ((const uint16_t *)in)[j];
+            break;
+        case MATRIX_UINT8:
+            for (int j = 0; j < cols; j++) out[j] = in[j];
+            break;
+        }
+    }
+}
+
+// Медиана не выходит за диапазон входа, так что сужение обратно в dtype без потерь
+void matrix_file_write_rows(MatrixFile *file, int first, int count, const Matrix *src, int src_row) {
+    int cols = (int)file->header.cols;
+    for (int k = 0; k < count; k++) {
+        unsigned char *out = file_row(file, first + k);
+        const int *in = matrix_row(src, src_row + k);
+        switch (file->header.dtype) {
+        case MATRIX_INT32:
+            memcpy(out, in, (size_t)cols * sizeof(int));
+            break;
+        case MATRIX_UINT16:
+            for (int j = 0; j < cols; j++) ((uint16_t *)out)[j] = (uint16_t)in[j];
+            break;
+        case MATRIX_UINT8:
+            for (int j = 0; j < cols; j++) out[j] = (unsigned char)in[j];
+            break;
+        }
+    }
+}
+
+void matrix_file_advise(const MatrixFile *file, int first, int count, int advice) {
+    if (count <= 0) return;
+    // madvise требует начала на границе страницы; лишние байты в начале безвредны
+    long page = sysconf(_SC_PAGESIZE);
+    size_t begin = file->header.data_offset + (size_t)first * file->header.stride;
+    size_t end = begin + (size_t)count * file->header.stride;
+    begin = begin / page * page;
+    madvise(file->map + begin, end - begin, advice);
+}
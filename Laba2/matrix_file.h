@@ -0,0 +1,57 @@
+#ifndef MATRIX_FILE_H
+#define MATRIX_FILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix.h"
+
+// Двоичный файл матрицы: заголовок MatrixFileHeader в начале, строки с data_offset
+// (начало страницы), каждая строка занимает stride байт и начинается с границы строки кэша.
+// Числа в заголовке и данных в порядке байт машины.
+#define MATRIX_FILE_MAGIC "MEDIANMX"
+#define MATRIX_FILE_VERSION 1
+#define MATRIX_FILE_DATA_OFFSET 4096
+
+typedef enum {
+    MATRIX_INT32 = 1,
+    MATRIX_UINT16 = 2,
+    MATRIX_UINT8 = 3
+} MatrixDtype;
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t dtype;        // MatrixDtype
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t stride;       // Байт между началами соседних строк
+    uint64_t data_offset;  // Начало данных от начала файла
+} MatrixFileHeader;
+
+// Файл, отображённый в память целиком; страницы подгружаются по мере обращения,
+// так что размер файла не ограничен объёмом памяти
+typedef struct {
+    int fd;
+    unsigned char *map;
+    size_t map_size;
+    MatrixFileHeader header;
+} MatrixFile;
+
+// Заголовок файла для матрицы rows x cols: строки по границе строки кэша, данные с MATRIX_FILE_DATA_OFFSET
+void matrix_file_header(MatrixFileHeader *header, int rows, int cols, MatrixDtype dtype);
+
+// Все функции при ошибке завершают программу с сообщением
+void matrix_file_open(MatrixFile *file, const char *path);
+void matrix_file_create(MatrixFile *file, const char *path, int rows, int cols, MatrixDtype dtype);
+void matrix_file_close(MatrixFile *file);
+
+// Строки [first, first + count) файла в строки dst, начиная с dst_row, с переводом в int
+void matrix_file_read_rows(const MatrixFile *file, int first, int count, Matrix *dst, int dst_row);
+// Строки src, начиная с src_row, в строки [first, first + count) файла
+void matrix_file_write_rows(MatrixFile *file, int first, int count, const Matrix *src, int src_row);
+// madvise для строк [first, first + count): MADV_WILLNEED - подгрузить заранее,
+// MADV_DONTNEED - отпустить уже не нужные страницы
+void matrix_file_advise(const MatrixFile *file, int first, int count, int advice);
+
+#endif // MATRIX_FILE_H
@@ -0,0 +1,186 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "matrix_file.h"
+#include "matrix_writer.h"
+#include "tiles.h"
+
+// Текст блока строк, который форматирует один поток
+#define WRITER_BLOCK_BYTES (256 * 1024)
+// Блоков на один writev; меньше IOV_MAX с запасом
+#define WRITER_GROUP 64
+// Самое длинное число с пробелом: "-2147483648 "
+#define CELL_MAX 12
+
+struct MatrixWriter {
+    int fd;
+    TilePool *pool;                  // NULL, если форматирует один поток
+    char *buffers[WRITER_GROUP];
+    size_t lengths[WRITER_GROUP];
+    size_t capacity;                 // Размер каждого буфера
+    int allocated;                   // Сколько буферов уже выделено
+    const Matrix *matrix;            // Что форматируется сейчас
+    Tile blocks[WRITER_GROUP];       // Блоки строк текущей группы
+};
+
+// Готовые "%3d " для 0..999: почти все значения фильтра укладываются сюда
+static char small_cells[1000][4];
+static pthread_once_t small_cells_once = PTHREAD_ONCE_INIT;
+
+static void fail(const char *message) {
+    write(STDERR_FILENO, message, strlen(message));
+    exit(EXIT_FAILURE);
+}
+
+static void init_small_cells(void) {
+    for (int value = 0; value < 1000; value++) {
+        char *cell = small_cells[value];
+        cell[0] = value >= 100 ? (char)('0' + value / 100) : ' ';
+        cell[1] = value >= 10 ? (char)('0' + value / 10 % 10) : ' ';
+        cell[2] = (char)('0' + value % 10);
+        cell[3] = ' ';
+    }
+}
+
+// То же, что snprintf("%3d ", value): знак входит в ширину, длинные числа не обрезаются
+static char *format_cell(char *out, int value) {
+    if ((unsigned)value < 1000) {
+        memcpy(out, small_cells[value], 4);
+        return out + 4;
+    }
+    char digits[CELL_MAX];
+    unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+    int n = 0;
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (value < 0) digits[n++] = '-';
+    for (int pad = n; pad < 3; pad++) *out++ = ' ';
+    while (n > 0) *out++ = digits[--n];
+    *out++ = ' ';
+    return out;
+}
+
+static void format_block(const Tile *block, int worker, void *context) {
+    (void)worker;
+    MatrixWriter *writer = (MatrixWriter *)context;
+    int index = (int)(block - writer->blocks);
+    char *out = writer->buffers[index];
+    for (int i = block->row_begin; i < block->row_end; i++) {
+        const int *row = matrix_row(writer->matrix, i);
+        for (int j = 0; j < writer->matrix->cols; j++) {
+            out = format_cell(out, row[j]);
+        }
+        *out++ = '\n';
+    }
+    writer->lengths[index] = (size_t)(out - writer->buffers[index]);
+}
+
+void write_all(int fd, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t written = writev(fd, iov, count);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            fail("Ошибка записи вывода\n");
+        }
+        // Пропускаем записанные буферы целиком, остаток первого недописанного сдвигаем
+        while (count > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+MatrixWriter *matrix_writer_create(int fd, int threads) {
+    pthread_once(&small_cells_once, init_small_cells);
+    MatrixWriter *writer = calloc(1, sizeof(MatrixWriter));
+    if (!writer) {
+        fail("Ошибка выделения памяти для вывода\n");
+    }
+    writer->fd = fd;
+    writer->pool = threads > 1 ? tile_pool_create(threads) : NULL;
+    return writer;
+}
+
+// Буферы под count блоков; при более широкой матрице все выделяются заново
+static void reserve_buffers(MatrixWriter *writer, size_t capacity, int count) {
+    if (capacity > writer->capacity) {
+        for (int k = 0; k < writer->allocated; k++) {
+            free(writer->buffers[k]);
+        }
+        writer->allocated = 0;
+        writer->capacity = capacity;
+    }
+    for (; writer->allocated < count; writer->allocated++) {
+        writer->buffers[writer->allocated] = malloc(writer->capacity);
+        if (!writer->buffers[writer->allocated]) {
+            fail("Ошибка выделения памяти для вывода\n");
+        }
+    }
+}
+
+void matrix_writer_text(MatrixWriter *writer, const char *title, const Matrix *matrix) {
+    size_t row_bytes = (size_t)matrix->cols * CELL_MAX + 1;
+    int rows_per_block = (int)(WRITER_BLOCK_BYTES / row_bytes);
+    if (rows_per_block < 1) rows_per_block = 1;
+    if (rows_per_block > matrix->rows) rows_per_block = matrix->rows > 0 ? matrix->rows : 1;
+    int blocks_total = (matrix->rows + rows_per_block - 1) / rows_per_block;
+    reserve_buffers(writer, rows_per_block * row_bytes, blocks_total < WRITER_GROUP ? blocks_total : WRITER_GROUP);
+    writer->matrix = matrix;
+
+    struct iovec iov[WRITER_GROUP + 1];
+    int count = 0;
+    iov[count].iov_base = (void *)title;
+    iov[count++].iov_len = strlen(title);
+    Tile *blocks = writer->blocks;
+    for (int r0 = 0; r0 < matrix->rows; r0 += WRITER_GROUP * rows_per_block) {
+        int block_count = 0;
+        for (int r = r0; r < matrix->rows && block_count < WRITER_GROUP; r += rows_per_block) {
+            Tile block = {r, r + rows_per_block < matrix->rows ? r + rows_per_block : matrix->rows, 0, matrix->cols};
+            blocks[block_count++] = block;
+        }
+        if (writer->pool && block_count > 1) {
+            tile_pool_run(writer->pool, blocks, block_count, format_block, writer, NULL);
+        } else {
+            for (int k = 0; k < block_count; k++) format_block(&blocks[k], 0, writer);
+        }
+        for (int k = 0; k < block_count; k++) {
+            iov[count].iov_base = writer->buffers[k];
+            iov[count++].iov_len = writer->lengths[k];
+        }
+        write_all(writer->fd, iov, count);
+        count = 0;
+    }
+    if (count > 0) write_all(writer->fd, iov, count);
+}
+
+void matrix_writer_binary(MatrixWriter *writer, const Matrix *matrix) {
+    // Строки Matrix уже выровнены на строку кэша, как и строки файла, поэтому
+    // данные идут одним куском, включая выравнивание в конце каждой строки
+    static const char padding[MATRIX_FILE_DATA_OFFSET];
+    MatrixFileHeader header;
+    matrix_file_header(&header, matrix->rows, matrix->cols, MATRIX_INT32);
+    struct iovec iov[3] = {
+        {&header, sizeof(header)},
+        {(void *)padding, header.data_offset - sizeof(header)},
+        {matrix->data, header.rows * header.stride}
+    };
+    write_all(writer->fd, iov, 3);
+}
+
+void matrix_writer_destroy(MatrixWriter *writer) {
+    if (writer->pool) tile_pool_destroy(writer->pool);
+    for (int k = 0; k < writer->allocated; k++) {
+        free(writer->buffers[k]);
+    }
+    free(writer);
+}
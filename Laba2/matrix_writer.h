@@ -0,0 +1,24 @@
+#ifndef MATRIX_WRITER_H
+#define MATRIX_WRITER_H
+
+#include <sys/uio.h>
+
+#include "matrix.h"
+
+// Вывод матриц большими порциями. Текст собирается в буферы блоков строк без printf,
+// блоки форматируются параллельно и уходят одним writev на группу. Двоичный вывод -
+// формат matrix_file, данные пишутся прямо из матрицы без копирования.
+typedef struct MatrixWriter MatrixWriter;
+
+// threads - сколько потоков форматируют текст; при ошибке завершает программу
+MatrixWriter *matrix_writer_create(int fd, int threads);
+// title и строки "%3d " через пробел, как у printf, каждая строка с "\n"
+void matrix_writer_text(MatrixWriter *writer, const char *title, const Matrix *matrix);
+// Заголовок MatrixFileHeader (int32), отступ до данных и строки с шагом stride
+void matrix_writer_binary(MatrixWriter *writer, const Matrix *matrix);
+void matrix_writer_destroy(MatrixWriter *writer);
+
+// Пишет count буферов целиком, продолжая после частичной записи; при ошибке завершает программу
+void write_all(int fd, struct iovec *iov, int count);
+
+#endif // MATRIX_WRITER_H
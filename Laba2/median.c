@@ -0,0 +1,351 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "median.h"
+
+void median_scratch_init(MedianScratch *scratch, int window_size) {
+    int span = 2 * (window_size / 2) + 1;
+    size_t area = (size_t)span * span;
+    scratch->span = span;
+    scratch->sorted = malloc(area * sizeof(int));
+    scratch->merged = malloc(area * sizeof(int));
+    scratch->columns = malloc((area + span) * sizeof(int));
+    scratch->histograms = NULL;
+    scratch->histogram_count = 0;
+    scratch->kernel = NULL;
+    scratch->fine_at = NULL;
+    scratch->kernel_count = 0;
+    scratch->network = median_network_select(span, &scratch->network_name);
+    if (!scratch->sorted || !scratch->merged || !scratch->columns) {
+        write(STDERR_FILENO, "Ошибка выделения памяти для окна\n", 61);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void median_scratch_free(MedianScratch *scratch) {
+    free(scratch->sorted);
+    free(scratch->merged);
+    free(scratch->columns);
+    free(scratch->histograms);
+    free(scratch->kernel);
+    free(scratch->fine_at);
+}
+
+// Копирует столбец col строк [r0, r1] и сортирует его вставками: столбец короткий
+static void load_column(const Matrix *src, int col, int r0, int r1, int *out) {
+    int height = r1 - r0 + 1;
+    for (int k = 0; k < height; k++) {
+        int value = MATRIX_AT(src, r0 + k, col);
+        int pos = k;
+        while (pos > 0 && out[pos - 1] > value) {
+            out[pos] = out[pos - 1];
+            pos--;
+        }
+        out[pos] = value;
+    }
+}
+
+// out = sorted - removed + added, все три отсортированы, removed входит в sorted.
+// Возвращает новое число элементов.
+static int merge_window(const int *sorted, int n, const int *removed, int r,
+                        const int *added, int a, int *out) {
+    int si = 0, ri = 0, ai = 0, k = 0;
+    while (si < n) {
+        int value = sorted[si++];
+        if (ri < r && removed[ri] == value) {
+            ri++;
+            continue;
+        }
+        while (ai < a && added[ai] < value) out[k++] = added[ai++];
+        out[k++] = value;
+    }
+    while (ai < a) out[k++] = added[ai++];
+    return k;
+}
+
+void median_sliding(const Matrix *src, Matrix *dst, int window_size,
+                    int row_begin, int row_end, int col_begin, int col_end, MedianScratch *scratch) {
+    int half = window_size / 2;
+    int span = scratch->span;
+    int slots = span + 1;
+    if (col_begin >= col_end) return;
+    // Окно обрезается только за ореолом
+    int top = -src->halo, bottom = src->rows + src->halo;
+    int left = -src->halo, right = src->cols + src->halo;
+
+    for (int i = row_begin; i < row_end; i++) {
+        int r0 = i - half < top ? top : i - half;
+        int r1 = i + half >= bottom ? bottom - 1 : i + half;
+        int height = r1 - r0 + 1;
+        int *out_row = matrix_row(dst, i);
+
+        // Начальное окно для col_begin
+        int n = 0;
+        int first = col_begin - half < left ? left : col_begin - half;
+        int last = col_begin + half >= right ? right - 1 : col_begin + half;
+        for (int c = first; c <= last; c++) {
+            int *column = scratch->columns + (size_t)((c - left) % slots) * span;
+            load_column(src, c, r0, r1, column);
+            n = merge_window(scratch->sorted, n, NULL, 0, column, height, scratch->merged);
+            int *swap = scratch->sorted;
+            scratch->sorted = scratch->merged;
+            scratch->merged = swap;
+        }
+
+        for (int j = col_begin; j < col_end; j++) {
+            out_row[j] = scratch->sorted[n / 2];
+            if (j + 1 == col_end) break;
+
+            // Сдвиг на один столбец: уходит j - half, приходит j + half + 1
+            int leaving = j - half;
+            int entering = j + half + 1;
+            const int *removed = NULL;
+            const int *added = NULL;
+            int r = 0, a = 0;
+            if (leaving >= left) {
+                removed = scratch->columns + (size_t)((leaving - left) % slots) * span;
+                r = height;
+            }
+            if (entering < right) {
+                int *column = scratch->columns + (size_t)((entering - left) % slots) * span;
+                load_column(src, entering, r0, r1, column);
+                added = column;
+                a = height;
+            }
+            if (r == 0 && a == 0) continue;
+            n = merge_window(scratch->sorted, n, removed, r, added, a, scratch->merged);
+            int *swap = scratch->sorted;
+            scratch->sorted = scratch->merged;
+            scratch->merged = swap;
+        }
+    }
+}
+
+// Точные корзины одной грубой: степень двойки, подобранная так, что грубых и точных примерно поровну
+static int fine_bits_for(unsigned range) {
+    int bits = 0;
+    while ((1ull << (2 * bits)) < range) bits++;
+    return bits;
+}
+
+static void grow_histograms(MedianScratch *scratch, size_t histogram_count, size_t kernel_count) {
+    if (histogram_count > scratch->histogram_count) {
+        free(scratch->histograms);
+        scratch->histograms = malloc(histogram_count * sizeof(uint16_t));
+        scratch->histogram_count = histogram_count;
+    }
+    if (kernel_count > scratch->kernel_count) {
+        free(scratch->kernel);
+        free(scratch->fine_at);
+        scratch->kernel = malloc(kernel_count * sizeof(uint32_t));
+        scratch->fine_at = malloc(kernel_count * sizeof(int));
+        scratch->kernel_count = kernel_count;
+    }
+    if (!scratch->histograms || !scratch->kernel || !scratch->fine_at) {
+        write(STDERR_FILENO, "Ошибка выделения памяти для гистограмм\n", 73);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void add_fine(uint32_t *kernel, const uint16_t *column, int count) {
+    for (int t = 0; t < count; t++) kernel[t] += column[t];
+}
+
+static void sub_fine(uint32_t *kernel, const uint16_t *column, int count) {
+    for (int t = 0; t < count; t++) kernel[t] -= column[t];
+}
+
+void median_histogram(const Matrix *src, Matrix *dst, int window_size,
+                      int row_begin, int row_end, int col_begin, int col_end,
+                      int min_value, int max_value, MedianScratch *scratch) {
+    int half = window_size / 2;
+    unsigned range = (unsigned)((long long)max_value - min_value + 1);
+    int fine_bits = fine_bits_for(range);
+    int fine = 1 << fine_bits;
+    int coarse = (int)((range + fine - 1) >> fine_bits);
+    size_t bins = (size_t)coarse * fine;
+    size_t column_size = bins + coarse;
+
+    // Полоса выходных столбцов, чьи гистограммы вместе с ореолом укладываются в бюджет
+    long stripe = (long)(MEDIAN_HISTOGRAM_BUDGET / (column_size * sizeof(uint16_t))) - 2 * half;
+    if (stripe < 16) stripe = 16;
+    if (stripe > col_end - col_begin) stripe = col_end - col_begin;
+    grow_histograms(scratch, (size_t)(stripe + 2 * half) * column_size, bins + coarse);
+    uint32_t *kernel_fine = scratch->kernel;
+    uint32_t *kernel_coarse = scratch->kernel + bins;
+    int *fine_at = scratch->fine_at;
+    int top = -src->halo, bottom = src->rows + src->halo;
+    int left = -src->halo, right = src->cols + src->halo;
+
+    for (int s0 = col_begin; s0 < col_end; s0 += (int)stripe) {
+        int s1 = s0 + (int)stripe < col_end ? s0 + (int)stripe : col_end;
+        int c_first = s0 - half < left ? left : s0 - half;
+        int c_last = s1 - 1 + half >= right ? right - 1 : s1 - 1 + half;
+        uint16_t *histograms = scratch->histograms;
+#define COLUMN_FINE(c) (histograms + (size_t)((c) - c_first) * column_size)
+#define COLUMN_COARSE(c) (COLUMN_FINE(c) + bins)
+#define HISTOGRAM_ADD(c, v, delta) do { \
+            unsigned index_ = (unsigned)(v) - (unsigned)min_value; \
+            COLUMN_FINE(c)[index_] += (delta); \
+            COLUMN_COARSE(c)[index_ >> fine_bits] += (delta); \
+        } while (0)
+
+        memset(COLUMN_FINE(c_first), 0, (size_t)(c_last - c_first + 1) * column_size * sizeof(uint16_t));
+        int r0 = row_begin - half < top ? top : row_begin - half;
+        int r1 = row_begin + half >= bottom ? bottom - 1 : row_begin + half;
+        for (int r = r0; r <= r1; r++) {
+            const int *row = matrix_row(src, r);
+            for (int c = c_first; c <= c_last; c++) HISTOGRAM_ADD(c, row[c], 1);
+        }
+
+        for (int i = row_begin; i < row_end; i++) {
+            // Окно сползает на строку вниз: каждый столбец теряет верхнее значение и получает нижнее
+            if (i > row_begin) {
+                if (i - half - 1 >= top) {
+                    const int *row = matrix_row(src, i - half - 1);
+                    for (int c = c_first; c <= c_last; c++) HISTOGRAM_ADD(c, row[c], -1);
+                    r0++;
+                }
+                if (i + half < bottom) {
+                    const int *row = matrix_row(src, i + half);
+                    for (int c = c_first; c <= c_last; c++) HISTOGRAM_ADD(c, row[c], 1);
+                    r1++;
+                }
+            }
+            int height = r1 - r0 + 1;
+            int *out_row = matrix_row(dst, i);
+
+            // Грубая гистограмма окна для s0 собирается заново, точные помечаются устаревшими
+            memset(kernel_coarse, 0, coarse * sizeof(uint32_t));
+            for (int b = 0; b < coarse; b++) fine_at[b] = INT_MIN;
+            int lo = s0 - half < left ? left : s0 - half;
+            int hi = s0 + half >= right ? right - 1 : s0 + half;
+            for (int c = lo; c <= hi; c++) {
+                const uint16_t *column = COLUMN_COARSE(c);
+                for (int b = 0; b < coarse; b++) kernel_coarse[b] += column[b];
+            }
+
+            for (int j = s0; j < s1; j++) {
+                if (j > s0) {
+                    if (j - half - 1 >= left) {
+                        const uint16_t *column = COLUMN_COARSE(j - half - 1);
+                        for (int b = 0; b < coarse; b++) kernel_coarse[b] -= column[b];
+                        lo++;
+                    }
+                    if (j + half < right) {
+                        const uint16_t *column = COLUMN_COARSE(j + half);
+                        for (int b = 0; b < coarse; b++) kernel_coarse[b] += column[b];
+                        hi++;
+                    }
+                }
+                uint32_t k = (uint32_t)(height * (hi - lo + 1)) / 2;
+
+                uint32_t below = 0;
+                int b = 0;
+                while (below + kernel_coarse[b] <= k) below += kernel_coarse[b++];
+
+                // Догоняем точную часть корзины b до текущего окна
+                uint32_t *kernel = kernel_fine + ((size_t)b << fine_bits);
+                int was = fine_at[b];
+                int stale = was == INT_MIN;   // Без проверки was - half переполнился бы
+                int was_lo = stale || was - half < left ? left : was - half;
+                int was_hi = stale || was + half >= right ? right - 1 : was + half;
+                size_t offset = (size_t)b << fine_bits;
+                if (stale || was_hi < lo) {
+                    memset(kernel, 0, fine * sizeof(uint32_t));
+                    for (int c = lo; c <= hi; c++) add_fine(kernel, COLUMN_FINE(c) + offset, fine);
+                } else {
+                    for (int c = was_lo; c < lo; c++) sub_fine(kernel, COLUMN_FINE(c) + offset, fine);
+                    for (int c = was_hi + 1; c <= hi; c++) add_fine(kernel, COLUMN_FINE(c) + offset, fine);
+                }
+                fine_at[b] = j;
+
+                int f = 0;
+                while (below + kernel[f] <= k) below += kernel[f++];
+                out_row[j] = (int)((unsigned)min_value + (unsigned)(offset + f));
+            }
+        }
+#undef HISTOGRAM_ADD
+#undef COLUMN_COARSE
+#undef COLUMN_FINE
+    }
+}
+
+void median_network(const Matrix *src, Matrix *dst, int window_size,
+                    int row_begin, int row_end, int col_begin, int col_end, MedianScratch *scratch) {
+    int half = window_size / 2;
+    // Внутренняя часть: строки и столбцы, где окно не выходит за матрицу с ореолом.
+    // При ореоле не меньше half это вся матрица, и median_sliding не нужен вовсе.
+    int reach = half - src->halo;
+    int inner_top = row_begin > reach ? row_begin : reach;
+    int inner_bottom = row_end < src->rows - reach ? row_end : src->rows - reach;
+    int inner_left = col_begin > reach ? col_begin : reach;
+    int inner_right = col_end < src->cols - reach ? col_end : src->cols - reach;
+    if (inner_top >= inner_bottom || inner_left >= inner_right) {
+        median_sliding(src, dst, window_size, row_begin, row_end, col_begin, col_end, scratch);
+        return;
+    }
+
+    median_sliding(src, dst, window_size, row_begin, inner_top, col_begin, col_end, scratch);
+    for (int i = inner_top; i < inner_bottom; i++) {
+        median_sliding(src, dst, window_size, i, i + 1, col_begin, inner_left, scratch);
+        scratch->network(src, dst, i, inner_left, inner_right);
+        median_sliding(src, dst, window_size, i, i + 1, inner_right, col_end, scratch);
+    }
+    median_sliding(src, dst, window_size, inner_bottom, row_end, col_begin, col_end, scratch);
+}
+
+// Диапазон значений, которые увидит окно при обработке прямоугольника
+static void region_range(const Matrix *src, int half, int row_begin, int row_end, int col_begin, int col_end,
+                         int *min_value, int *max_value) {
+    int r0 = row_begin - half < -src->halo ? -src->halo : row_begin - half;
+    int r1 = row_end + half > src->rows + src->halo ? src->rows + src->halo : row_end + half;
+    int c0 = col_begin - half < -src->halo ? -src->halo : col_begin - half;
+    int c1 = col_end + half > src->cols + src->halo ? src->cols + src->halo : col_end + half;
+    int lo = INT_MAX, hi = INT_MIN;
+    for (int r = r0; r < r1; r++) {
+        const int *row = matrix_row(src, r);
+        for (int c = c0; c < c1; c++) {
+            if (row[c] < lo) lo = row[c];
+            if (row[c] > hi) hi = row[c];
+        }
+    }
+    *min_value = lo;
+    *max_value = hi;
+}
+
+MedianEngine median_filter(const Matrix *src, Matrix *dst, int window_size,
+                           int row_begin, int row_end, int col_begin, int col_end, MedianScratch *scratch) {
+    if (row_begin >= row_end || col_begin >= col_end) return MEDIAN_SLIDING;
+    const char *forced = getenv("MEDIAN_ENGINE");
+    // Маленьким окнам сети выгоднее любого другого движка и не требуют просмотра диапазона
+    if (scratch->network && !(forced && strcmp(forced, "network") != 0)) {
+        median_network(src, dst, window_size, row_begin, row_end, col_begin, col_end, scratch);
+        return MEDIAN_NETWORK;
+    }
+    int half = window_size / 2;
+    int min_value, max_value;
+    region_range(src, half, row_begin, row_end, col_begin, col_end, &min_value, &max_value);
+    long long range = (long long)max_value - min_value + 1;
+
+    // Пиксель гистограммы стоит примерно как (грубых + точных) / 2 элементов отсортированного
+    // окна из span^2, так что маленьким окнам и широкому диапазону она не выгодна
+    MedianEngine engine = MEDIAN_SLIDING;
+    if (range <= MEDIAN_HISTOGRAM_MAX_RANGE && scratch->span < 65536) {
+        int fine = 1 << fine_bits_for((unsigned)range);
+        int coarse = (int)((range + fine - 1) / fine);
+        if ((long long)scratch->span * scratch->span > (coarse + fine) / 2) engine = MEDIAN_HISTOGRAM;
+        if (forced && strcmp(forced, "histogram") == 0) engine = MEDIAN_HISTOGRAM;
+        if (forced && strcmp(forced, "sliding") == 0) engine = MEDIAN_SLIDING;
+    }
+
+    if (engine == MEDIAN_HISTOGRAM) {
+        median_histogram(src, dst, window_size, row_begin, row_end, col_begin, col_end,
+                         min_value, max_value, scratch);
+    } else {
+        median_sliding(src, dst, window_size, row_begin, row_end, col_begin, col_end, scratch);
+    }
+    return engine;
+}
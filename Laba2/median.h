@@ -0,0 +1,71 @@
+#ifndef MEDIAN_H
+#define MEDIAN_H
+
+#include <stdint.h>
+
+#include "matrix.h"
+#include "median_network.h"
+
+// Гистограммный режим берётся, только если значения области укладываются в столько корзин
+#define MEDIAN_HISTOGRAM_MAX_RANGE 65536
+// Столбцовые гистограммы одной полосы стараются уложить в этот объём (примерно L2)
+#define MEDIAN_HISTOGRAM_BUDGET (2 * 1024 * 1024)
+
+typedef enum {
+    MEDIAN_SLIDING,    // Отсортированное окно, любой диапазон int
+    MEDIAN_HISTOGRAM,  // Гистограммы по столбцам, ограниченный диапазон значений
+    MEDIAN_NETWORK     // Сети min/max по соседним пикселям, окна 3x3, 5x5 и 7x7
+} MedianEngine;
+
+// Рабочая память одного потока для скользящего окна. Окно обрезается по краю матрицы
+// вместе с её ореолом (Matrix.halo), и медианой считается элемент с номером count / 2
+// среди count попавших в окно. С ореолом не меньше половины окна обрезки нет совсем.
+typedef struct {
+    int *sorted;   // Содержимое окна по возрастанию
+    int *merged;   // Буфер слияния, после каждого шага меняется местами с sorted
+    int *columns;  // Кольцо отсортированных столбцов окна: span + 1 слотов по span элементов
+    int span;      // Сторона окна: 2 * (window_size / 2) + 1
+    // Гистограммный режим, выделяется при первом использовании и растёт по необходимости
+    uint16_t *histograms;   // Гистограммы столбцов полосы: точные корзины, затем грубые
+    size_t histogram_count;
+    uint32_t *kernel;       // Гистограмма окна: точные корзины, затем грубые
+    int *fine_at;           // Для какого столбца точная часть грубой корзины актуальна
+    size_t kernel_count;
+    median_row_fn network;  // Сеть для этого окна или NULL
+    const char *network_name;
+} MedianScratch;
+
+// При ошибке выделения памяти завершает программу
+void median_scratch_init(MedianScratch *scratch, int window_size);
+void median_scratch_free(MedianScratch *scratch);
+
+// Медианный фильтр прямоугольника [row_begin, row_end) x [col_begin, col_end) из src в dst.
+// Окно движется вдоль строки: каждый столбец сортируется один раз, а при сдвиге на одну
+// позицию уходящий и приходящий столбцы сливаются с окном за один линейный проход.
+// Сравнение без вычитания, поэтому годится весь диапазон int.
+void median_sliding(const Matrix *src, Matrix *dst, int window_size,
+                    int row_begin, int row_end, int col_begin, int col_end, MedianScratch *scratch);
+
+// Гистограммный медианный фильтр в духе Perreault-Hebert: у каждого столбца полосы своя
+// гистограмма по высоте окна, при переходе на следующую строку она меняется на два значения.
+// Гистограмма окна двухуровневая: грубые корзины сдвигаются вместе с окном, а точная часть
+// грубой корзины догоняется лениво, только когда в неё попадает медиана. Стоимость пикселя
+// порядка sqrt(диапазона) и не зависит от размера окна. Все значения области вместе
+// с ореолом окна должны лежать в [min_value, max_value], диапазон не больше MEDIAN_HISTOGRAM_MAX_RANGE.
+void median_histogram(const Matrix *src, Matrix *dst, int window_size,
+                      int row_begin, int row_end, int col_begin, int col_end,
+                      int min_value, int max_value, MedianScratch *scratch);
+
+// Сеть отбора медианы для внутренних пикселей, у которых окно целиком в матрице, векторно
+// по соседним пикселям строки; края с обрезанным окном считает median_sliding.
+// Нужна scratch->network, то есть окно 3x3, 5x5 или 7x7.
+void median_network(const Matrix *src, Matrix *dst, int window_size,
+                    int row_begin, int row_end, int col_begin, int col_end, MedianScratch *scratch);
+
+// Общая точка входа: смотрит на диапазон значений области и размер окна и выбирает движок.
+// Переменная окружения MEDIAN_ENGINE=sliding|histogram|network принудительно задаёт движок,
+// если он применим к данным.
+MedianEngine median_filter(const Matrix *src, Matrix *dst, int window_size,
+                           int row_begin, int row_end, int col_begin, int col_end, MedianScratch *scratch);
+
+#endif // MEDIAN_H
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "median_network.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MEDIAN_X86 1
+#include <immintrin.h>
+#endif
+
+// Обмены сети над массивом v; KMIN и KMAX задаются перед каждой версией ядра
+#define NET_CX(a, b) { VEC_T lo_ = KMIN(v[a], v[b]); v[b] = KMAX(v[a], v[b]); v[a] = lo_; }
+#define NET_LO(a, b) v[a] = KMIN(v[a], v[b]);
+#define NET_HI(a, b) v[b] = KMAX(v[a], v[b]);
+
+// Цикл по LANES соседним пикселям: вход e сети - вектор из строки окна e / SPAN, сдвинутый
+// на e % SPAN столбцов, так что каждая полоса вектора считает медиану своего пикселя.
+// Развёртка загрузок даёт компилятору держать v в регистрах, а не в массиве.
+#define NETWORK_LOOP(N, SPAN, LANES)                                                        \
+    const int *rows[SPAN];                                                                  \
+    for (int r = 0; r < SPAN; r++) rows[r] = matrix_row(src, i - SPAN / 2 + r) - SPAN / 2;  \
+    int *out = matrix_row(dst, i);                                                          \
+    for (; j + LANES <= col_end; j += LANES) {                                              \
+        VEC_T v[N];                                                                         \
+        _Pragma("GCC unroll 64")                                                            \
+        for (int e = 0; e < N; e++) v[e] = VEC_LOAD(rows[e / SPAN] + j + e % SPAN);         \
+        MEDIAN_NETWORK_##N(NET_CX, NET_LO, NET_HI)                                          \
+        VEC_STORE(out + j, v[N / 2]);                                                       \
+    }
+
+#define DEFINE_SCALAR(N, SPAN)                                                                        \
+static void network_##N##_scalar(const Matrix *src, Matrix *dst, int i, int col_begin, int col_end) { \
+    int j = col_begin;                                                                                \
+    NETWORK_LOOP(N, SPAN, 1)                                                                          \
+}
+
+// Векторная версия доделывает хвост строки короче вектора скалярной
+#define DEFINE_VECTOR(N, SPAN, ISA, TARGET, LANES)                                                    \
+__attribute__((target(TARGET)))                                                                       \
+static void network_##N##_##ISA(const Matrix *src, Matrix *dst, int i, int col_begin, int col_end) {  \
+    int j = col_begin;                                                                                \
+    NETWORK_LOOP(N, SPAN, LANES)                                                                      \
+    if (j < col_end) network_##N##_scalar(src, dst, i, j, col_end);                                   \
+}
+
+#define VEC_T int
+#define VEC_LOAD(p) (*(p))
+#define VEC_STORE(p, x) (*(p) = (x))
+#define KMIN(a, b) ((a) < (b) ? (a) : (b))
+#define KMAX(a, b) ((a) < (b) ? (b) : (a))
+DEFINE_SCALAR(9, 3)
+DEFINE_SCALAR(25, 5)
+DEFINE_SCALAR(49, 7)
+#undef VEC_T
+#undef VEC_LOAD
+#undef VEC_STORE
+#undef KMIN
+#undef KMAX
+
+#ifdef MEDIAN_X86
+
+#define VEC_T __m128i
+#define VEC_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define VEC_STORE(p, x) _mm_storeu_si128((__m128i *)(p), (x))
+#define KMIN(a, b) _mm_min_epi32((a), (b))
+#define KMAX(a, b) _mm_max_epi32((a), (b))
+DEFINE_VECTOR(9, 3, sse41, "sse4.1", 4)
+DEFINE_VECTOR(25, 5, sse41, "sse4.1", 4)
+DEFINE_VECTOR(49, 7, sse41, "sse4.1", 4)
+#undef VEC_T
+#undef VEC_LOAD
+#undef VEC_STORE
+#undef KMIN
+#undef KMAX
+
+#define VEC_T __m256i
+#define VEC_LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define VEC_STORE(p, x) _mm256_storeu_si256((__m256i *)(p), (x))
+#define KMIN(a, b) _mm256_min_epi32((a), (b))
+#define KMAX(a, b) _mm256_max_epi32((a), (b))
+DEFINE_VECTOR(9, 3, avx2, "avx2", 8)
+DEFINE_VECTOR(25, 5, avx2, "avx2", 8)
+DEFINE_VECTOR(49, 7, avx2, "avx2", 8)
+#undef VEC_T
+#undef VEC_LOAD
+#undef VEC_STORE
+#undef KMIN
+#undef KMAX
+
+#define VEC_T __m512i
+#define VEC_LOAD(p) _mm512_loadu_si512((const void *)(p))
+#define VEC_STORE(p, x) _mm512_storeu_si512((void *)(p), (x))
+#define KMIN(a, b) _mm512_min_epi32((a), (b))
+#define KMAX(a, b) _mm512_max_epi32((a), (b))
+DEFINE_VECTOR(9, 3, avx512, "avx512f", 16)
+DEFINE_VECTOR(25, 5, avx512, "avx512f", 16)
+DEFINE_VECTOR(49, 7, avx512, "avx512f", 16)
+#undef VEC_T
+#undef VEC_LOAD
+#undef VEC_STORE
+#undef KMIN
+#undef KMAX
+
+#endif // MEDIAN_X86
+
+typedef struct {
+    const char *name;
+    median_row_fn kernels[3];  // Окна 3x3, 5x5, 7x7
+} NetworkVersion;
+
+// Все версии, которые поддерживает текущий процессор, от простой к лучшей
+static int available_versions(NetworkVersion *versions) {
+    int n = 0;
+    versions[n++] = (NetworkVersion){"scalar", {network_9_scalar, network_25_scalar, network_49_scalar}};
+#ifdef MEDIAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.1")) {
+        versions[n++] = (NetworkVersion){"sse4.1", {network_9_sse41, network_25_sse41, network_49_sse41}};
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        versions[n++] = (NetworkVersion){"avx2", {network_9_avx2, network_25_avx2, network_49_avx2}};
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        versions[n++] = (NetworkVersion){"avx512", {network_9_avx512, network_25_avx512, network_49_avx512}};
+    }
+#endif
+    return n;
+}
+
+median_row_fn median_network_select(int span, const char **name) {
+    if (span != 3 && span != 5 && span != 7) return NULL;
+    NetworkVersion versions[4];
+    int n = available_versions(versions);
+    int chosen = n - 1;
+    const char *forced = getenv("MEDIAN_KERNEL");
+    if (forced) {
+        for (int k = 0; k < n; k++) {
+            if (strcmp(versions[k].name, forced) == 0) chosen = k;
+        }
+    }
+    if (name) *name = versions[chosen].name;
+    return versions[chosen].kernels[span / 2 - 1];
+}
@@ -0,0 +1,79 @@
+#ifndef MEDIAN_NETWORK_H
+#define MEDIAN_NETWORK_H
+
+#include "matrix.h"
+
+// Сети отбора медианы для окон 3x3, 5x5 и 7x7. Это сортирующая сеть Батчера (odd-even merge)
+// на ближайшую степень двойки без компараторов, задевающих лишние входы, из которой выброшено
+// всё, что не влияет на средний выход. CX(a, b) - полный обмен (min в a, max в b), а там,
+// где дальше нужен только один выход, остаётся половина: LO(a, b) - только min в a,
+// HI(a, b) - только max в b. Элемент окна (r, c) - вход r * span + c, медиана - выход n / 2.
+// 9 входов: 40 операций min/max, 25: 202, 49: 590.
+#define MEDIAN_NETWORK_9(CX, LO, HI) \
+    CX(0, 1) CX(2, 3) CX(4, 5) CX(6, 7) CX(0, 2) CX(1, 3) CX(4, 6) CX(5, 7) CX(1, 2) CX(5, 6) \
+    CX(0, 4) CX(1, 5) CX(2, 6) LO(3, 7) CX(2, 4) CX(3, 5) HI(1, 2) CX(3, 4) LO(5, 6) HI(0, 8) \
+    LO(4, 8) HI(2, 4) LO(3, 5) HI(3, 4)
+
+#define MEDIAN_NETWORK_25(CX, LO, HI) \
+    CX(0, 1) CX(2, 3) CX(4, 5) CX(6, 7) CX(8, 9) CX(10, 11) CX(12, 13) CX(14, 15) CX(16, 17) \
+    CX(18, 19) CX(20, 21) CX(22, 23) CX(0, 2) CX(1, 3) CX(4, 6) CX(5, 7) CX(8, 10) CX(9, 11) \
+    CX(12, 14) CX(13, 15) CX(16, 18) CX(17, 19) CX(20, 22) CX(21, 23) CX(1, 2) CX(5, 6) CX(9, 10) \
+    CX(13, 14) CX(17, 18) CX(21, 22) CX(0, 4) CX(1, 5) CX(2, 6) CX(3, 7) CX(8, 12) CX(9, 13) \
+    CX(10, 14) CX(11, 15) CX(16, 20) CX(17, 21) CX(18, 22) CX(19, 23) CX(2, 4) CX(3, 5) CX(10, 12) \
+    CX(11, 13) CX(18, 20) CX(19, 21) CX(1, 2) CX(3, 4) CX(5, 6) CX(9, 10) CX(11, 12) CX(13, 14) \
+    CX(17, 18) CX(19, 20) CX(21, 22) CX(0, 8) CX(1, 9) CX(2, 10) CX(3, 11) CX(4, 12) CX(5, 13) \
+    CX(6, 14) LO(7, 15) CX(16, 24) CX(4, 8) CX(5, 9) CX(6, 10) CX(7, 11) CX(20, 24) CX(2, 4) \
+    CX(3, 5) CX(6, 8) CX(7, 9) CX(10, 12) CX(11, 13) CX(18, 20) CX(19, 21) CX(22, 24) CX(1, 2) \
+    CX(3, 4) CX(5, 6) CX(7, 8) CX(9, 10) CX(11, 12) LO(13, 14) CX(17, 18) CX(19, 20) CX(21, 22) \
+    CX(23, 24) HI(0, 16) HI(1, 17) HI(2, 18) HI(3, 19) HI(4, 20) HI(5, 21) LO(6, 22) LO(7, 23) \
+    LO(8, 24) HI(8, 16) HI(9, 17) LO(10, 18) LO(11, 19) LO(12, 20) LO(13, 21) HI(6, 10) HI(7, 11) \
+    LO(12, 16) LO(13, 17) HI(10, 12) LO(11, 13) HI(11, 12)
+
+#define MEDIAN_NETWORK_49(CX, LO, HI) \
+    CX(0, 1) CX(2, 3) CX(4, 5) CX(6, 7) CX(8, 9) CX(10, 11) CX(12, 13) CX(14, 15) CX(16, 17) \
+    CX(18, 19) CX(20, 21) CX(22, 23) CX(24, 25) CX(26, 27) CX(28, 29) CX(30, 31) CX(32, 33) \
+    CX(34, 35) CX(36, 37) CX(38, 39) CX(40, 41) CX(42, 43) CX(44, 45) CX(46, 47) CX(0, 2) CX(1, 3) \
+    CX(4, 6) CX(5, 7) CX(8, 10) CX(9, 11) CX(12, 14) CX(13, 15) CX(16, 18) CX(17, 19) CX(20, 22) \
+    CX(21, 23) CX(24, 26) CX(25, 27) CX(28, 30) CX(29, 31) CX(32, 34) CX(33, 35) CX(36, 38) \
+    CX(37, 39) CX(40, 42) CX(41, 43) CX(44, 46) CX(45, 47) CX(1, 2) CX(5, 6) CX(9, 10) CX(13, 14) \
+    CX(17, 18) CX(21, 22) CX(25, 26) CX(29, 30) CX(33, 34) CX(37, 38) CX(41, 42) CX(45, 46) CX(0, 4) \
+    CX(1, 5) CX(2, 6) CX(3, 7) CX(8, 12) CX(9, 13) CX(10, 14) CX(11, 15) CX(16, 20) CX(17, 21) \
+    CX(18, 22) CX(19, 23) CX(24, 28) CX(25, 29) CX(26, 30) CX(27, 31) CX(32, 36) CX(33, 37) \
+    CX(34, 38) CX(35, 39) CX(40, 44) CX(41, 45) CX(42, 46) CX(43, 47) CX(2, 4) CX(3, 5) CX(10, 12) \
+    CX(11, 13) CX(18, 20) CX(19, 21) CX(26, 28) CX(27, 29) CX(34, 36) CX(35, 37) CX(42, 44) \
+    CX(43, 45) CX(1, 2) CX(3, 4) CX(5, 6) CX(9, 10) CX(11, 12) CX(13, 14) CX(17, 18) CX(19, 20) \
+    CX(21, 22) CX(25, 26) CX(27, 28) CX(29, 30) CX(33, 34) CX(35, 36) CX(37, 38) CX(41, 42) \
+    CX(43, 44) CX(45, 46) CX(0, 8) CX(1, 9) CX(2, 10) CX(3, 11) CX(4, 12) CX(5, 13) CX(6, 14) \
+    CX(7, 15) CX(16, 24) CX(17, 25) CX(18, 26) CX(19, 27) CX(20, 28) CX(21, 29) CX(22, 30) \
+    CX(23, 31) CX(32, 40) CX(33, 41) CX(34, 42) CX(35, 43) CX(36, 44) CX(37, 45) CX(38, 46) \
+    CX(39, 47) CX(4, 8) CX(5, 9) CX(6, 10) CX(7, 11) CX(20, 24) CX(21, 25) CX(22, 26) CX(23, 27) \
+    CX(36, 40) CX(37, 41) CX(38, 42) CX(39, 43) CX(2, 4) CX(3, 5) CX(6, 8) CX(7, 9) CX(10, 12) \
+    CX(11, 13) CX(18, 20) CX(19, 21) CX(22, 24) CX(23, 25) CX(26, 28) CX(27, 29) CX(34, 36) \
+    CX(35, 37) CX(38, 40) CX(39, 41) CX(42, 44) CX(43, 45) CX(1, 2) CX(3, 4) CX(5, 6) CX(7, 8) \
+    CX(9, 10) CX(11, 12) CX(13, 14) CX(17, 18) CX(19, 20) CX(21, 22) CX(23, 24) CX(25, 26) \
+    CX(27, 28) CX(29, 30) CX(33, 34) CX(35, 36) CX(37, 38) CX(39, 40) CX(41, 42) CX(43, 44) \
+    CX(45, 46) CX(0, 16) CX(1, 17) CX(2, 18) CX(3, 19) CX(4, 20) CX(5, 21) CX(6, 22) CX(7, 23) \
+    CX(8, 24) CX(9, 25) CX(10, 26) CX(11, 27) CX(12, 28) CX(13, 29) LO(14, 30) LO(15, 31) CX(32, 48) \
+    CX(8, 16) CX(9, 17) CX(10, 18) CX(11, 19) CX(12, 20) CX(13, 21) CX(14, 22) CX(15, 23) CX(40, 48) \
+    CX(4, 8) CX(5, 9) CX(6, 10) CX(7, 11) CX(12, 16) CX(13, 17) CX(14, 18) CX(15, 19) CX(20, 24) \
+    CX(21, 25) CX(22, 26) CX(23, 27) CX(36, 40) CX(37, 41) CX(38, 42) CX(39, 43) CX(44, 48) CX(2, 4) \
+    CX(3, 5) CX(6, 8) CX(7, 9) CX(10, 12) CX(11, 13) CX(14, 16) CX(15, 17) CX(18, 20) CX(19, 21) \
+    CX(22, 24) CX(23, 25) CX(26, 28) LO(27, 29) CX(34, 36) CX(35, 37) CX(38, 40) CX(39, 41) \
+    CX(42, 44) CX(43, 45) CX(46, 48) CX(1, 2) CX(3, 4) CX(5, 6) CX(7, 8) CX(9, 10) CX(11, 12) \
+    CX(13, 14) CX(15, 16) CX(17, 18) CX(19, 20) CX(21, 22) CX(23, 24) CX(25, 26) LO(27, 28) \
+    CX(33, 34) CX(35, 36) CX(37, 38) CX(39, 40) CX(41, 42) CX(43, 44) CX(45, 46) CX(47, 48) \
+    HI(0, 32) HI(1, 33) HI(2, 34) HI(3, 35) HI(4, 36) HI(5, 37) HI(6, 38) HI(7, 39) HI(8, 40) \
+    HI(9, 41) HI(10, 42) HI(11, 43) LO(12, 44) LO(13, 45) LO(14, 46) LO(15, 47) LO(16, 48) \
+    HI(16, 32) HI(17, 33) HI(18, 34) HI(19, 35) LO(20, 36) LO(21, 37) LO(22, 38) LO(23, 39) \
+    LO(24, 40) LO(25, 41) LO(26, 42) LO(27, 43) HI(12, 20) HI(13, 21) HI(14, 22) HI(15, 23) \
+    LO(24, 32) LO(25, 33) LO(26, 34) LO(27, 35) HI(20, 24) HI(21, 25) LO(22, 26) LO(23, 27) \
+    HI(22, 24) LO(23, 25) HI(23, 24)
+
+// Медианы строки i для столбцов [col_begin, col_end); окно целиком внутри матрицы
+typedef void (*median_row_fn)(const Matrix *src, Matrix *dst, int i, int col_begin, int col_end);
+
+// Лучшая версия сети для стороны окна span (3, 5 или 7) или NULL для других окон.
+// Выбирается по cpuid, MEDIAN_KERNEL=scalar|sse4.1|avx2|avx512 задаёт версию явно.
+median_row_fn median_network_select(int span, const char **name);
+
+#endif // MEDIAN_NETWORK_H
@@ -0,0 +1,146 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "reduce.h"
+
+// Циклы ниже без зависимостей между итерациями, кроме самой свёртки,
+// так что компилятор разворачивает их в векторные min/max и сложения
+
+static void min_max_init(const Reduction *self, void *state) {
+    (void)self;
+    MinMaxState *s = (MinMaxState *)state;
+    s->min = INT_MAX;
+    s->max = INT_MIN;
+}
+
+static void min_max_accumulate(const Reduction *self, void *state, const int *values, int count) {
+    (void)self;
+    MinMaxState *s = (MinMaxState *)state;
+    int lo = s->min, hi = s->max;
+    for (int j = 0; j < count; j++) {
+        lo = values[j] < lo ? values[j] : lo;
+        hi = values[j] > hi ? values[j] : hi;
+    }
+    s->min = lo;
+    s->max = hi;
+}
+
+static void min_max_merge(const Reduction *self, void *into, const void *from) {
+    (void)self;
+    MinMaxState *a = (MinMaxState *)into;
+    const MinMaxState *b = (const MinMaxState *)from;
+    if (b->min < a->min) a->min = b->min;
+    if (b->max > a->max) a->max = b->max;
+}
+
+static void mean_init(const Reduction *self, void *state) {
+    (void)self;
+    memset(state, 0, sizeof(MeanState));
+}
+
+static void mean_accumulate(const Reduction *self, void *state, const int *values, int count) {
+    (void)self;
+    MeanState *s = (MeanState *)state;
+    long long sum = 0;
+    for (int j = 0; j < count; j++) sum += values[j];
+    s->sum += sum;
+    s->count += count;
+}
+
+static void mean_merge(const Reduction *self, void *into, const void *from) {
+    (void)self;
+    MeanState *a = (MeanState *)into;
+    const MeanState *b = (const MeanState *)from;
+    a->sum += b->sum;
+    a->count += b->count;
+}
+
+static void above_init(const Reduction *self, void *state) {
+    (void)self;
+    memset(state, 0, sizeof(AboveState));
+}
+
+static void above_accumulate(const Reduction *self, void *state, const int *values, int count) {
+    AboveState *s = (AboveState *)state;
+    long long threshold = self->parameter;
+    long long above = 0;
+    for (int j = 0; j < count; j++) above += values[j] > threshold;
+    s->count += above;
+}
+
+static void above_merge(const Reduction *self, void *into, const void *from) {
+    (void)self;
+    ((AboveState *)into)->count += ((const AboveState *)from)->count;
+}
+
+const Reduction reduction_min_max = {"min_max", sizeof(MinMaxState), min_max_init, min_max_accumulate, min_max_merge, 0};
+const Reduction reduction_mean = {"mean", sizeof(MeanState), mean_init, mean_accumulate, mean_merge, 0};
+const Reduction reduction_above = {"above", sizeof(AboveState), above_init, above_accumulate, above_merge, 0};
+
+void reduction_set_init(ReductionSet *set) {
+    memset(set, 0, sizeof(*set));
+}
+
+int reduction_add(ReductionSet *set, const Reduction *reduction) {
+    if (set->count == REDUCTION_MAX) {
+        write(STDERR_FILENO, "Ошибка: слишком много свёрток\n", 55);
+        exit(EXIT_FAILURE);
+    }
+    // Состояния внутри блока потока выравниваются на 8 байт
+    set->offsets[set->count] = set->stride;
+    set->stride += (reduction->state_size + 7) / 8 * 8;
+    set->items[set->count] = reduction;
+    return set->count++;
+}
+
+void reduction_prepare(ReductionSet *set, int workers) {
+    set->stride = (set->stride + MATRIX_ALIGNMENT - 1) / MATRIX_ALIGNMENT * MATRIX_ALIGNMENT;
+    if (set->stride == 0) set->stride = MATRIX_ALIGNMENT;
+    set->workers = workers;
+    void *states = NULL;
+    if (posix_memalign(&states, MATRIX_ALIGNMENT, set->stride * workers) != 0) {
+        write(STDERR_FILENO, "Ошибка выделения памяти для свёрток\n", 67);
+        exit(EXIT_FAILURE);
+    }
+    set->states = states;
+    reduction_reset(set);
+}
+
+void reduction_reset(ReductionSet *set) {
+    for (int w = 0; w < set->workers; w++) {
+        for (int k = 0; k < set->count; k++) {
+            set->items[k]->init(set->items[k], set->states + w * set->stride + set->offsets[k]);
+        }
+    }
+}
+
+void reduction_rows(ReductionSet *set, int worker, const Matrix *result,
+                    int row_begin, int row_end, int col_begin, int col_end) {
+    unsigned char *block = set->states + worker * set->stride;
+    for (int i = row_begin; i < row_end; i++) {
+        const int *row = matrix_row(result, i) + col_begin;
+        for (int k = 0; k < set->count; k++) {
+            set->items[k]->accumulate(set->items[k], block + set->offsets[k], row, col_end - col_begin);
+        }
+    }
+}
+
+void reduction_finish(ReductionSet *set) {
+    for (int w = 1; w < set->workers; w++) {
+        for (int k = 0; k < set->count; k++) {
+            set->items[k]->merge(set->items[k], set->states + set->offsets[k],
+                                 set->states + w * set->stride + set->offsets[k]);
+        }
+    }
+}
+
+const void *reduction_result(const ReductionSet *set, int index) {
+    return set->states + set->offsets[index];
+}
+
+void reduction_set_free(ReductionSet *set) {
+    free(set->states);
+    set->states = NULL;
+}
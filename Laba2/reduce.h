@@ -0,0 +1,69 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <stddef.h>
+
+#include "matrix.h"
+
+// Сколько свёрток можно подключить к одному прогону
+#define REDUCTION_MAX 8
+
+// Свёртка результата фильтра. Каждый поток копит своё состояние по готовым плиткам,
+// пока они ещё в кэше, и ни с кем его не делит; после завершения потоков состояния
+// сливаются по одному разу. Новая статистика - это ещё одна такая структура.
+typedef struct Reduction Reduction;
+struct Reduction {
+    const char *name;
+    size_t state_size;
+    void (*init)(const Reduction *self, void *state);
+    // Добавить count значений подряд из строки результата
+    void (*accumulate)(const Reduction *self, void *state, const int *values, int count);
+    void (*merge)(const Reduction *self, void *into, const void *from);
+    long long parameter;   // Например, порог для reduction_above
+};
+
+typedef struct {
+    int min;
+    int max;
+} MinMaxState;
+
+typedef struct {
+    long long sum;
+    long long count;
+} MeanState;
+
+typedef struct {
+    long long count;
+} AboveState;
+
+extern const Reduction reduction_min_max;
+extern const Reduction reduction_mean;
+extern const Reduction reduction_above;   // Значения больше parameter
+
+// Состояния всех подключённых свёрток для каждого потока; у каждого потока свой блок,
+// выровненный на строку кэша
+typedef struct {
+    const Reduction *items[REDUCTION_MAX];
+    size_t offsets[REDUCTION_MAX];
+    int count;
+    int workers;
+    size_t stride;
+    unsigned char *states;
+} ReductionSet;
+
+void reduction_set_init(ReductionSet *set);
+// Возвращает номер свёртки в наборе; подключать до reduction_prepare
+int reduction_add(ReductionSet *set, const Reduction *reduction);
+// Выделяет и обнуляет состояния для workers потоков; при ошибке завершает программу
+void reduction_prepare(ReductionSet *set, int workers);
+// Возвращает состояния к начальным перед следующим прогоном
+void reduction_reset(ReductionSet *set);
+// Прогоняет прямоугольник результата через все свёртки потока worker
+void reduction_rows(ReductionSet *set, int worker, const Matrix *result,
+                    int row_begin, int row_end, int col_begin, int col_end);
+// Сливает состояния всех потоков; после этого reduction_result отдаёт итог
+void reduction_finish(ReductionSet *set);
+const void *reduction_result(const ReductionSet *set, int index);
+void reduction_set_free(ReductionSet *set);
+
+#endif // REDUCE_H
@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tiles.h"
+
+// Если размер L2 не сообщается системой
+#define DEFAULT_L2 (1024 * 1024)
+// Ширина плитки: достаточно длинные строки для векторных ядер
+#define TILE_MAX_COLS 512
+
+typedef struct {
+    TilePool *pool;
+    int worker;
+} TileWorker;
+
+struct TilePool {
+    int threads;
+    pthread_t *handles;
+    TileWorker *workers;
+    TileQueue *queues;
+    pthread_mutex_t lock;
+    pthread_cond_t start;      // Новый прогон или завершение пула
+    pthread_cond_t done;       // Последний поток закончил прогон
+    unsigned long generation;  // Номер текущего прогона
+    int running;               // Потоков, ещё не закончивших прогон
+    int shutdown;
+    // Текущий прогон
+    const Tile *tiles;
+    tile_fn fn;
+    void *context;
+    WorkerStats *stats;
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+Tile *make_tiles(int rows, int cols, int window_size, int threads, int *count) {
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 <= 0) l2 = DEFAULT_L2;
+    int halo = 2 * (window_size / 2);
+    int tile_cols = cols < TILE_MAX_COLS ? cols : TILE_MAX_COLS;
+    // Вход с ореолом и выход плитки: (h + halo) * (w + halo) + h * w элементов
+    long tile_rows = (l2 / 2) / ((long)(tile_cols + halo) * 2 * sizeof(int)) - halo / 2;
+    if (tile_rows < 1) tile_rows = 1;
+    if (tile_rows > rows) tile_rows = rows;
+
+    int col_tiles = (cols + tile_cols - 1) / tile_cols;
+    int row_tiles = (int)((rows + tile_rows - 1) / tile_rows);
+    while ((long)row_tiles * col_tiles < 4L * threads && tile_rows > 1) {
+        tile_rows = (tile_rows + 1) / 2;
+        row_tiles = (int)((rows + tile_rows - 1) / tile_rows);
+    }
+
+    Tile *tiles = malloc((size_t)row_tiles * col_tiles * sizeof(Tile));
+    if (!tiles) {
+        write(STDERR_FILENO, "Ошибка выделения памяти для плиток\n", 65);
+        exit(EXIT_FAILURE);
+    }
+    int n = 0;
+    for (int r = 0; r < rows; r += (int)tile_rows) {
+        for (int c = 0; c < cols; c += tile_cols) {
+            tiles[n].row_begin = r;
+            tiles[n].row_end = r + tile_rows < rows ? r + (int)tile_rows : rows;
+            tiles[n].col_begin = c;
+            tiles[n].col_end = c + tile_cols < cols ? c + tile_cols : cols;
+            n++;
+        }
+    }
+    *count = n;
+    return tiles;
+}
+
+// Своя плитка с головы очереди; -1, если очередь пуста
+static int pop_own(TileQueue *queue) {
+    int index = -1;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->head < queue->tail) index = queue->head++;
+    pthread_mutex_unlock(&queue->lock);
+    return index;
+}
+
+// Забирает вторую половину чужой очереди в свою пустую и возвращает первую из забранных плиток
+static int steal(TilePool *pool, int worker, long *stolen) {
+    for (int k = 1; k < pool->threads; k++) {
+        TileQueue *victim = &pool->queues[(worker + k) % pool->threads];
+        pthread_mutex_lock(&victim->lock);
+        int left = victim->tail - victim->head;
+        if (left <= 0) {
+            pthread_mutex_unlock(&victim->lock);
+            continue;
+        }
+        int take = (left + 1) / 2;
+        int begin = victim->tail - take;
+        victim->tail = begin;
+        pthread_mutex_unlock(&victim->lock);
+
+        TileQueue *own = &pool->queues[worker];
+        pthread_mutex_lock(&own->lock);
+        own->head = begin + 1;
+        own->tail = begin + take;
+        pthread_mutex_unlock(&own->lock);
+        *stolen += take;
+        return begin;
+    }
+    return -1;
+}
+
+// Один прогон глазами потока worker
+static void run_worker(TilePool *pool, int worker) {
+    WorkerStats stats = {0, 0, 0.0, 0.0};
+    double start = now_seconds();
+    for (;;) {
+        int index = pop_own(&pool->queues[worker]);
+        if (index < 0) index = steal(pool, worker, &stats.stolen);
+        if (index < 0) break;  // Плитки не порождают новых, так что пусто везде - значит всё
+        double begin = now_seconds();
+        pool->fn(&pool->tiles[index], worker, pool->context);
+        stats.busy += now_seconds() - begin;
+        stats.tiles++;
+    }
+    stats.wall = now_seconds() - start;
+    if (pool->stats) pool->stats[worker] = stats;
+}
+
+static void *tile_worker(void *arg) {
+    TileWorker *self = (TileWorker *)arg;
+    TilePool *pool = self->pool;
+    unsigned long seen = 0;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        while (pool->generation == seen && !pool->shutdown) pthread_cond_wait(&pool->start, &pool->lock);
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        seen = pool->generation;
+        pthread_mutex_unlock(&pool->lock);
+
+        run_worker(pool, self->worker);
+
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->running == 0) pthread_cond_signal(&pool->done);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return NULL;
+}
+
+TilePool *tile_pool_create(int threads) {
+    TilePool *pool = calloc(1, sizeof(TilePool));
+    if (pool) {
+        pool->queues = malloc(threads * sizeof(TileQueue));
+        pool->workers = malloc(threads * sizeof(TileWorker));
+        pool->handles = malloc(threads * sizeof(pthread_t));
+    }
+    if (!pool || !pool->queues || !pool->workers || !pool->handles) {
+        write(STDERR_FILENO, "Ошибка выделения памяти для потоков\n", 67);
+        exit(EXIT_FAILURE);
+    }
+    pool->threads = threads;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int i = 0; i < threads; i++) {
+        pthread_mutex_init(&pool->queues[i].lock, NULL);
+        pool->queues[i].head = pool->queues[i].tail = 0;
+        pool->workers[i].pool = pool;
+        pool->workers[i].worker = i;
+    }
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool->handles[i], NULL, tile_worker, &pool->workers[i]) != 0) {
+            write(STDERR_FILENO, "Ошибка создания потока\n", 43);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+void tile_pool_run(TilePool *pool, const Tile *tiles, int count, tile_fn fn, void *context, WorkerStats *stats) {
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < pool->threads; i++) {
+        pool->queues[i].head = (int)((long)count * i / pool->threads);
+        pool->queues[i].tail = (int)((long)count * (i + 1) / pool->threads);
+    }
+    pool->tiles = tiles;
+    pool->fn = fn;
+    pool->context = context;
+    pool->stats = stats;
+    pool->running = pool->threads;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    while (pool->running > 0) pthread_cond_wait(&pool->done, &pool->lock);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void tile_pool_destroy(TilePool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->threads; i++) {
+        if (pthread_join(pool->handles[i], NULL) != 0) {
+            write(STDERR_FILENO, "Ошибка завершения потока\n", 47);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (int i = 0; i < pool->threads; i++) pthread_mutex_destroy(&pool->queues[i].lock);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->start);
+    pthread_cond_destroy(&pool->done);
+    free(pool->queues);
+    free(pool->workers);
+    free(pool->handles);
+    free(pool);
+}
@@ -0,0 +1,50 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <pthread.h>
+
+// Прямоугольник выходной матрицы [row_begin, row_end) x [col_begin, col_end)
+typedef struct {
+    int row_begin;
+    int row_end;
+    int col_begin;
+    int col_end;
+} Tile;
+
+// Обработка одной плитки потоком worker (0 .. threads - 1)
+typedef void (*tile_fn)(const Tile *tile, int worker, void *context);
+
+// Что сделал поток: busy - время внутри tile_fn, wall - время жизни потока
+typedef struct {
+    long tiles;
+    long stolen;   // Сколько плиток забрано у других потоков
+    double busy;
+    double wall;
+} WorkerStats;
+
+// Очередь плиток потока: владелец берёт с головы, воры забирают половину с хвоста.
+// Каждая очередь в своей строке кэша, чтобы потоки не мешали друг другу.
+typedef struct {
+    pthread_mutex_t lock;
+    int head;
+    int tail;
+    char padding[64];
+} TileQueue;
+
+// Режет матрицу на плитки, которые вместе с ореолом окна помещаются в половину L2,
+// и мельчит их, пока на поток не придётся хотя бы четыре. Массив выделяется malloc.
+Tile *make_tiles(int rows, int cols, int window_size, int threads, int *count);
+
+// Постоянный пул потоков: создаётся один раз и обрабатывает прогон за прогоном,
+// так что между кадрами не платим ни за создание потоков, ни за холодные кэши их стеков
+typedef struct TilePool TilePool;
+
+// При ошибке создания потока завершает программу
+TilePool *tile_pool_create(int threads);
+// Обрабатывает все плитки потоками пула и возвращается, когда готовы все. Сначала каждый
+// поток получает непрерывный участок плиток, освободившийся поток ворует у занятых.
+// stats - массив на число потоков пула или NULL. Вызывать из одного потока.
+void tile_pool_run(TilePool *pool, const Tile *tiles, int count, tile_fn fn, void *context, WorkerStats *stats);
+void tile_pool_destroy(TilePool *pool);
+
+#endif // TILES_H
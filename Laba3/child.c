@@ -7,8 +7,9 @@
 #include <stdlib.h>
 #include <errno.h>
 
+#include "../common/vowel_filter.h"
+
 #define FILE_SIZE 4096
-#define BUFFER_SIZE 256
 
 volatile sig_atomic_t parent_signaled = 0;
 
@@ -18,15 +19,14 @@ void handle_signal(int signo) {
     }
 }
 
-void remove_vowels(const char *input, char *output) {
-    const char *vowels = "aeiouAEIOU";
-    int j = 0;
-    for (int i = 0; input[i] != '\0'; i++) {
-        if (strchr(vowels, input[i]) == NULL) {
-            output[j++] = input[i];
-        }
-    }
-    output[j] = '\0';
+// Строка приходит целиком в кодировке UTF-8: удаляются латинские и кириллические гласные,
+// оборванная в конце последовательность переносится как есть
+void remove_vowels(vf_kernel kernel, const vf_charset *vowels, const char *input, char *output) {
+    size_t len = strlen(input);
+    size_t consumed;
+    size_t kept = vf_filter_utf8(kernel.fn, vowels, input, len, output, &consumed);
+    memcpy(output + kept, input + consumed, len - consumed);
+    output[kept + len - consumed] = '\0';
 }
 
 int main(int argc, char *argv[]) {
@@ -63,15 +63,19 @@ int main(int argc, char *argv[]) {
         exit(EXIT_FAILURE);
     }
 
-    char result[BUFFER_SIZE];
+    // Отображение может содержать до FILE_SIZE - 1 символов, результат не длиннее входа
+    char result[FILE_SIZE];
+    vf_kernel kernel = vf_select_kernel();
+    vf_charset vowels;
+    vf_charset_build(&vowels, VF_VOWELS_SPEC, NULL);
 
     while (1) {
         while (!parent_signaled);
         parent_signaled = 0;
 
-        remove_vowels(mapped_memory, result);
+        remove_vowels(kernel, &vowels, mapped_memory, result);
 
-        strncpy(mapped_memory, result, FILE_SIZE - 1);
+        memcpy(mapped_memory, result, strlen(result) + 1);
 
         kill(getppid(), SIGUSR1);
     }
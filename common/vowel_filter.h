@@ -0,0 +1,396 @@
+#ifndef VOWEL_FILTER_H
+#define VOWEL_FILTER_H
+
+/*
+ * Ядро удаления гласных, общее для Laba1/remove_vowels.cpp и Laba3/child.c.
+ *
+ * Удаляемые байты задаются множеством vf_charset: таблицей на 256 байт и её
+ * упакованной по полубайтам копией для векторных версий. Множество строится из
+ * описания вида "AEIOUaeiou" или "a-z\x80-\xff" (диапазоны через '-', экранирование
+ * \n \t \r \\ \- \xHH). Разбор написан так, что в C++ выполняется на этапе
+ * компиляции (constexpr), а в C и для опций командной строки — при запуске.
+ *
+ * Все реализации имеют один контракт: переносят из in в out байты, не входящие во
+ * множество, сохраняя порядок, и возвращают их количество. Буфер out должен вмещать
+ * len байт и не пересекаться с in.
+ *
+ * Векторные версии классифицируют блок байт двумя pshufb по младшему полубайту
+ * (строки таблицы для старших полубайтов 0-7 и 8-f) и маской бита старшего полубайта,
+ * после чего упаковывают оставшиеся байты влево: SSE4.2/AVX2 через pshufb по таблице
+ * перестановок для каждых 8 байт, AVX-512 через vpcompressb. Лучшая версия выбирается
+ * один раз по cpuid, переменная окружения VOWEL_KERNEL=scalar|sse4.2|avx2|avx512
+ * позволяет выбрать версию явно.
+ *
+ * vf_filter_utf8 дополнительно удаляет гласные кириллицы в UTF-8. Участки из одних
+ * ASCII байт отдаются выбранному векторному ядру, декодер включается только на
+ * байтах >= 0x80, поэтому на почти ASCII тексте скорость остаётся прежней.
+ *
+ * Заголовок самодостаточен (все функции static), подключается как из C, так и из C++.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VF_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__)
+#define VF_UNUSED __attribute__((unused))
+#else
+#define VF_UNUSED
+#endif
+
+#if defined(__cplusplus) && __cplusplus >= 201402L
+#define VF_CONSTEXPR constexpr
+#else
+#define VF_CONSTEXPR
+#endif
+
+#define VF_VOWELS_SPEC "AEIOUaeiou"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    unsigned char drop[256];       // 1 — байт удаляется
+    unsigned char nibble_lo[16];   // Бит k: удаляется байт (k << 4) | lo, k = 0..7
+    unsigned char nibble_hi[16];   // Бит k: удаляется байт ((k + 8) << 4) | lo
+} vf_charset;
+
+typedef size_t (*vf_kernel_fn)(const vf_charset *set, const char *in, size_t len, char *out);
+
+typedef struct {
+    const char *name;
+    vf_kernel_fn fn;
+} vf_kernel;
+
+VF_UNUSED static VF_CONSTEXPR int vf_hex_digit(char c) {
+    return c >= '0' && c <= '9' ? c - '0'
+         : c >= 'a' && c <= 'f' ? c - 'a' + 10
+         : c >= 'A' && c <= 'F' ? c - 'A' + 10
+         : -1;
+}
+
+// Читает один символ описания с учётом экранирования; возвращает байт или -1 при ошибке
+VF_UNUSED static VF_CONSTEXPR int vf_spec_char(const char *spec, size_t *pos) {
+    unsigned char c = (unsigned char)spec[*pos];
+    (*pos)++;
+    if (c != '\\') return c;
+    c = (unsigned char)spec[*pos];
+    if (c == '\0') return -1;
+    (*pos)++;
+    if (c == 'n') return '\n';
+    if (c == 't') return '\t';
+    if (c == 'r') return '\r';
+    if (c == 'x') {
+        int high = vf_hex_digit(spec[*pos]);
+        int low = high < 0 ? -1 : vf_hex_digit(spec[*pos + 1]);
+        if (low < 0) return -1;
+        *pos += 2;
+        return high * 16 + low;
+    }
+    return c;
+}
+
+// Отмечает в mark байты из описания; 0 при успехе, -1 при ошибке
+VF_UNUSED static VF_CONSTEXPR int vf_charset_mark(unsigned char *mark, const char *spec) {
+    size_t pos = 0;
+    while (spec[pos] != '\0') {
+        int first = vf_spec_char(spec, &pos);
+        if (first < 0) return -1;
+        int last = first;
+        // '-' в конце описания — обычный символ
+        if (spec[pos] == '-' && spec[pos + 1] != '\0') {
+            pos++;
+            last = vf_spec_char(spec, &pos);
+            if (last < first) return -1;
+        }
+        for (int c = first; c <= last; c++) mark[c] = 1;
+    }
+    return 0;
+}
+
+// Строит полубайтовые таблицы по готовой таблице drop
+VF_UNUSED static VF_CONSTEXPR void vf_charset_finish(vf_charset *set) {
+    for (int lo = 0; lo < 16; lo++) {
+        unsigned char low = 0, high = 0;
+        for (int k = 0; k < 8; k++) {
+            if (set->drop[(k << 4) | lo]) low = (unsigned char)(low | (1 << k));
+            if (set->drop[((k + 8) << 4) | lo]) high = (unsigned char)(high | (1 << k));
+        }
+        set->nibble_lo[lo] = low;
+        set->nibble_hi[lo] = high;
+    }
+}
+
+// Множество из описаний удаляемых (drop) и оставляемых (keep) байт. Удаляются байты
+// из drop и, если keep задан, все байты не из keep. Возвращает -1 при ошибке в описании.
+VF_UNUSED static VF_CONSTEXPR int vf_charset_build(vf_charset *set, const char *drop, const char *keep) {
+    for (int c = 0; c < 256; c++) set->drop[c] = 0;
+    if (drop != NULL && vf_charset_mark(set->drop, drop) != 0) return -1;
+    if (keep != NULL) {
+        unsigned char kept[256] = {0};
+        if (vf_charset_mark(kept, keep) != 0) return -1;
+        for (int c = 0; c < 256; c++) {
+            if (!kept[c]) set->drop[c] = 1;
+        }
+    }
+    vf_charset_finish(set);
+    return 0;
+}
+
+VF_UNUSED static size_t vf_filter_scalar(const vf_charset *set, const char *in, size_t len, char *out) {
+    size_t j = 0;
+    for (size_t i = 0; i < len; i++) {
+        out[j] = in[i];
+        j += !set->drop[(unsigned char)in[i]];
+    }
+    return j;
+}
+
+#ifdef VF_X86
+
+// Для каждой 8-битной маски оставляемых байт: индексы этих байт подряд, остаток 0x80
+static unsigned char vf_pack_lut[256][8];
+static int vf_pack_lut_ready = 0;
+
+VF_UNUSED static void vf_init_pack_lut(void) {
+    if (vf_pack_lut_ready) return;
+    for (int mask = 0; mask < 256; mask++) {
+        int k = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            if (mask & (1 << bit)) vf_pack_lut[mask][k++] = (unsigned char)bit;
+        }
+        while (k < 8) vf_pack_lut[mask][k++] = 0x80;
+    }
+    vf_pack_lut_ready = 1;
+}
+
+// Бит старшего полубайта (по модулю 8), одинаков для обеих половин таблицы
+#define VF_NIBBLE_BITS 1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128
+
+// Маска оставляемых байт: 0xFF там, где байт не входит во множество
+__attribute__((target("sse4.2,popcnt")))
+VF_UNUSED static __m128i vf_keep_mask_128(const vf_charset *set, __m128i v) {
+    const __m128i nibble = _mm_set1_epi8(0x0F);
+    __m128i lo = _mm_and_si128(v, nibble);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), nibble);
+    __m128i rows_lo = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)set->nibble_lo), lo);
+    __m128i rows_hi = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)set->nibble_hi), lo);
+    __m128i rows = _mm_blendv_epi8(rows_lo, rows_hi, v); // Старший бит байта выбирает половину
+    __m128i bit = _mm_shuffle_epi8(_mm_setr_epi8(VF_NIBBLE_BITS), hi);
+    return _mm_cmpeq_epi8(_mm_and_si128(rows, bit), _mm_setzero_si128());
+}
+
+// Упаковка 16 байт по 16-битной маске оставляемых байт, возвращает новую позицию в out
+__attribute__((target("sse4.2,popcnt")))
+VF_UNUSED static size_t vf_pack_128(__m128i v, unsigned keep, char *out, size_t j) {
+    if (keep == 0xFFFF) {
+        _mm_storeu_si128((__m128i *)(out + j), v);
+        return j + 16;
+    }
+    unsigned lo = keep & 0xFF, hi = keep >> 8;
+    __m128i packed = _mm_shuffle_epi8(v, _mm_loadl_epi64((const __m128i *)vf_pack_lut[lo]));
+    _mm_storel_epi64((__m128i *)(out + j), packed);
+    j += _mm_popcnt_u32(lo);
+    packed = _mm_shuffle_epi8(_mm_srli_si128(v, 8), _mm_loadl_epi64((const __m128i *)vf_pack_lut[hi]));
+    _mm_storel_epi64((__m128i *)(out + j), packed);
+    return j + _mm_popcnt_u32(hi);
+}
+
+__attribute__((target("sse4.2,popcnt")))
+VF_UNUSED static size_t vf_filter_sse42(const vf_charset *set, const char *in, size_t len, char *out) {
+    size_t i = 0, j = 0;
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        unsigned keep = (unsigned)_mm_movemask_epi8(vf_keep_mask_128(set, v));
+        j = vf_pack_128(v, keep, out, j);
+    }
+    return j + vf_filter_scalar(set, in + i, len - i, out + j);
+}
+
+__attribute__((target("avx2,popcnt")))
+VF_UNUSED static size_t vf_filter_avx2(const vf_charset *set, const char *in, size_t len, char *out) {
+    size_t i = 0, j = 0;
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    const __m256i table_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->nibble_lo));
+    const __m256i table_hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)set->nibble_hi));
+    const __m256i bits = _mm256_setr_epi8(VF_NIBBLE_BITS, VF_NIBBLE_BITS);
+    for (; i + 32 <= len; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        __m256i lo = _mm256_and_si256(v, nibble);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+        __m256i rows = _mm256_blendv_epi8(_mm256_shuffle_epi8(table_lo, lo), _mm256_shuffle_epi8(table_hi, lo), v);
+        __m256i member = _mm256_and_si256(rows, _mm256_shuffle_epi8(bits, hi));
+        unsigned keep = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(member, _mm256_setzero_si256()));
+        if (keep == 0xFFFFFFFFu) {
+            _mm256_storeu_si256((__m256i *)(out + j), v);
+            j += 32;
+            continue;
+        }
+        j = vf_pack_128(_mm256_castsi256_si128(v), keep & 0xFFFF, out, j);
+        j = vf_pack_128(_mm256_extracti128_si256(v, 1), keep >> 16, out, j);
+    }
+    return j + vf_filter_scalar(set, in + i, len - i, out + j);
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vbmi2,popcnt")))
+VF_UNUSED static size_t vf_filter_avx512(const vf_charset *set, const char *in, size_t len, char *out) {
+    size_t i = 0, j = 0;
+    const __m512i nibble = _mm512_set1_epi8(0x0F);
+    const __m512i table_lo = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128((const __m128i *)set->nibble_lo));
+    const __m512i table_hi = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_loadu_si128((const __m128i *)set->nibble_hi));
+    const __m512i bits = _mm512_maskz_broadcast_i32x4(0xFFFF, _mm_setr_epi8(VF_NIBBLE_BITS));
+    while (i < len) {
+        size_t n = len - i < 64 ? len - i : 64;
+        __mmask64 valid = n == 64 ? ~(__mmask64)0 : (((__mmask64)1 << n) - 1);
+        __m512i v = _mm512_maskz_loadu_epi8(valid, in + i);
+        __m512i lo = _mm512_and_si512(v, nibble);
+        __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), nibble);
+        __m512i rows = _mm512_mask_blend_epi8(_mm512_movepi8_mask(v), _mm512_shuffle_epi8(table_lo, lo),
+                                              _mm512_shuffle_epi8(table_hi, lo));
+        __mmask64 keep = _mm512_testn_epi8_mask(rows, _mm512_shuffle_epi8(bits, hi)) & valid;
+        if (n == 64) {
+            // Сжатие в регистре и полная запись дешевле compress-store в память;
+            // запись не выходит за len, так как j не превышает уже прочитанное
+            _mm512_storeu_si512((void *)(out + j), _mm512_maskz_compress_epi8(keep, v));
+        } else {
+            _mm512_mask_compressstoreu_epi8(out + j, keep, v);
+        }
+        j += _mm_popcnt_u64(keep);
+        i += n;
+    }
+    return j;
+}
+
+#endif /* VF_X86 */
+
+// Все версии ядра, которые поддерживает текущий процессор, от простой к лучшей
+VF_UNUSED static size_t vf_available_kernels(vf_kernel *kernels, size_t capacity) {
+    size_t n = 0;
+    if (n < capacity) { kernels[n].name = "scalar"; kernels[n].fn = vf_filter_scalar; n++; }
+#ifdef VF_X86
+    vf_init_pack_lut();
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt") && n < capacity) {
+        kernels[n].name = "sse4.2"; kernels[n].fn = vf_filter_sse42; n++;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") && n < capacity) {
+        kernels[n].name = "avx2"; kernels[n].fn = vf_filter_avx2; n++;
+    }
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vbmi2") && n < capacity) {
+        kernels[n].name = "avx512"; kernels[n].fn = vf_filter_avx512; n++;
+    }
+#endif
+    return n;
+}
+
+// Выбор ядра: VOWEL_KERNEL, если задана и поддерживается, иначе лучшее доступное
+VF_UNUSED static vf_kernel vf_select_kernel(void) {
+    vf_kernel kernels[8];
+    size_t n = vf_available_kernels(kernels, 8);
+    const char *forced = getenv("VOWEL_KERNEL");
+    if (forced) {
+        for (size_t k = 0; k < n; k++) {
+            if (strcmp(kernels[k].name, forced) == 0) return kernels[k];
+        }
+    }
+    return kernels[n - 1];
+}
+
+// Гласные кириллицы в UTF-8 двухбайтовые с ведущим байтом 0xD0 или 0xD1;
+// для каждого ведущего байта бит (второй байт - 0x80) отмечает гласную
+#define VF_CONT(c) (1ULL << ((c) - 0x80))
+// Ё А Е И О У Ы Э Ю Я а е и о
+static const unsigned long long vf_cyrillic_d0 =
+    VF_CONT(0x81) | VF_CONT(0x90) | VF_CONT(0x95) | VF_CONT(0x98) | VF_CONT(0x9E) | VF_CONT(0xA3) | VF_CONT(0xAB) |
+    VF_CONT(0xAD) | VF_CONT(0xAE) | VF_CONT(0xAF) | VF_CONT(0xB0) | VF_CONT(0xB5) | VF_CONT(0xB8) | VF_CONT(0xBE);
+// у ы э ю я ё
+static const unsigned long long vf_cyrillic_d1 =
+    VF_CONT(0x83) | VF_CONT(0x8B) | VF_CONT(0x8D) | VF_CONT(0x8E) | VF_CONT(0x8F) | VF_CONT(0x91);
+#undef VF_CONT
+
+// Длина начального участка без байт >= 0x80
+VF_UNUSED static size_t vf_ascii_prefix(const char *in, size_t len) {
+    size_t i = 0;
+#if defined(VF_X86) && defined(__SSE2__)
+    for (; i + 16 <= len; i += 16) {
+        unsigned high = (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(in + i)));
+        if (high) return i + (size_t)__builtin_ctz(high);
+    }
+#endif
+    while (i < len && !((unsigned char)in[i] & 0x80)) i++;
+    return i;
+}
+
+// Длина последовательности UTF-8 по ведущему байту, 0 для байта, который не может её начинать
+static size_t vf_utf8_length(unsigned char lead) {
+    if (lead < 0x80) return 1;
+    if (lead >= 0xC2 && lead <= 0xDF) return 2;
+    if (lead >= 0xE0 && lead <= 0xEF) return 3;
+    if (lead >= 0xF0 && lead <= 0xF4) return 4;
+    return 0;
+}
+
+/*
+ * Фильтр для текста в UTF-8: ASCII байты фильтруются ядром fn по множеству set,
+ * из многобайтовых последовательностей удаляются гласные кириллицы, остальные и
+ * некорректные байты переносятся как есть. Последовательность, оборванная концом
+ * буфера, не обрабатывается: в *consumed возвращается, сколько байт входа разобрано,
+ * остаток нужно передать вместе со следующим блоком (или вывести как есть в конце).
+ */
+VF_UNUSED static size_t vf_filter_utf8(vf_kernel_fn fn, const vf_charset *set, const char *in, size_t len,
+                                        char *out, size_t *consumed) {
+    size_t i = 0, j = 0;
+    while (i < len) {
+        size_t run = vf_ascii_prefix(in + i, len - i);
+        if (run > 0) {
+            j += fn(set, in + i, run, out + j);
+            i += run;
+        }
+        // Декодер работает, пока впереди не найдётся 16 байт подряд чистого ASCII
+        while (i < len) {
+            unsigned char c = (unsigned char)in[i];
+            if (c < 0x80) {
+                if (len - i >= 16 && vf_ascii_prefix(in + i, 16) == 16) break;
+                if (!set->drop[c]) out[j++] = (char)c;
+                i++;
+                continue;
+            }
+            size_t n = vf_utf8_length(c), k = 1;
+            while (k < n && i + k < len && ((unsigned char)in[i + k] & 0xC0) == 0x80) k++;
+            if (n != 0 && k < n && i + k == len) {
+                *consumed = i;
+                return j;
+            }
+            if (k < n || n == 0) {
+                out[j++] = (char)c; // Некорректный байт
+                i++;
+                continue;
+            }
+            if (n == 2) {
+                unsigned long long vowels = c == 0xD0 ? vf_cyrillic_d0 : c == 0xD1 ? vf_cyrillic_d1 : 0;
+                if (vowels >> ((unsigned char)in[i + 1] - 0x80) & 1) {
+                    i += 2;
+                    continue;
+                }
+            }
+            memcpy(out + j, in + i, n);
+            i += n;
+            j += n;
+        }
+    }
+    *consumed = len;
+    return j;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* VOWEL_FILTER_H */